@@ -1,22 +1,28 @@
 # Copyright (c) Microsoft Corporation. 
 # Licensed under the MIT license.
 
-from tree_sitter import Language, Parser
+# Builds my-languages.so from every grammar cloned next to this file through
+# CMakeLists.txt (-O3, LTO). Language.build_library, which this used to call,
+# is gone from py-tree-sitter; load languages with languages.language(name),
+# or from Node with native/bindings/node/languages.js.
 
-Language.build_library(
-  # Store the library in the `build` directory
-  'my-languages.so',
+import glob
+import os
+import shutil
+import subprocess
 
-  # Include one or more languages
-  [
-    'tree-sitter-go',
-    'tree-sitter-javascript',
-    'tree-sitter-python',
-    'tree-sitter-php',
-    'tree-sitter-java',
-    'tree-sitter-ruby',
-    'tree-sitter-c-sharp',
-    'tree-sitter-coolgen',
-  ]
-)
+here = os.path.dirname(os.path.abspath(__file__))
+build_dir = os.path.join(here, 'build')
 
+subprocess.check_call(['cmake', '-S', here, '-B', build_dir,
+                       '-DCMAKE_BUILD_TYPE=Release'])
+subprocess.check_call(['cmake', '--build', build_dir, '--config', 'Release'])
+
+# Multi-config generators (Visual Studio) put them under build/Release.
+# my-languages.node, the registry for Node, is only built where node and nan
+# are installed.
+for name in ['my-languages.so', 'my-languages.node']:
+    built = (glob.glob(os.path.join(build_dir, name)) +
+             glob.glob(os.path.join(build_dir, '*', name)))
+    if built or name == 'my-languages.so':
+        shutil.copy(built[0], os.path.join(here, name))
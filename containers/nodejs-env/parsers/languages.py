@@ -0,0 +1,55 @@
+# Copyright (c) Microsoft Corporation. 
+# Licensed under the MIT license.
+
+# Languages from my-languages.so (see build.py), looked up by grammar name:
+#
+#   from languages import language
+#   parser = Parser()
+#   parser.set_language(language('coolgen'))
+#
+# Only the grammars asked for are ever touched, however many the library has.
+
+import ctypes
+import os
+
+from tree_sitter import Language
+
+LIBRARY_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                            'my-languages.so')
+
+_library = None
+_languages = {}
+
+
+def _registry():
+    global _library
+    if _library is None:
+        library = ctypes.cdll.LoadLibrary(LIBRARY_PATH)
+        library.ts_languages_get.argtypes = [ctypes.c_char_p]
+        library.ts_languages_get.restype = ctypes.c_void_p
+        library.ts_languages_count.restype = ctypes.c_size_t
+        library.ts_languages_name.argtypes = [ctypes.c_size_t]
+        library.ts_languages_name.restype = ctypes.c_char_p
+        _library = library
+    return _library
+
+
+def names():
+    library = _registry()
+    return [library.ts_languages_name(i).decode()
+            for i in range(library.ts_languages_count())]
+
+
+def language(name):
+    key = name.lower()
+    if key not in _languages:
+        pointer = _registry().ts_languages_get(name.encode())
+        if not pointer:
+            raise ValueError('%s is not in %s (has: %s)'
+                             % (name, LIBRARY_PATH, ', '.join(names())))
+        try:
+            _languages[key] = Language(pointer)
+        except TypeError:
+            # py-tree-sitter 0.21 still wants a name next to the pointer.
+            _languages[key] = Language(pointer, name)
+    return _languages[key]
@@ -0,0 +1,221 @@
+// Measures the COBOL external scanner alone, in scan calls per second:
+//
+//   cobol_scanner_bench [--rounds N] [FILE ...]
+//
+// Without files it reads tree-sitter-cobol-main/test/cobol85/src and
+// test/custom/src. A fake lexer walks each file as the runtime's lexer
+// would: at every token boundary it scans with one of the valid symbol sets
+// the grammar produces, takes the token when the scanner returns one and
+// otherwise skips the word. The scanner is linked in directly, so the
+// numbers cover its lexing without the parser around it.
+//
+// Built by CMakeLists.txt (target cobol_scanner_bench); it does not need
+// the tree-sitter runtime.
+
+#include "tree_sitter/parser.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+bool tree_sitter_COBOL_external_scanner_scan(void *payload, TSLexer *lexer,
+                                             const bool *valid_symbols);
+
+enum {
+    WHITE_SPACES,
+    LINE_PREFIX_COMMENT,
+    LINE_SUFFIX_COMMENT,
+    LINE_COMMENT,
+    COMMENT_ENTRY,
+    MULTILINE_STRING,
+    EXEC_SQL,
+    COMPILER_DIRECTIVE,
+    TOKEN_COUNT,
+};
+
+typedef struct {
+    TSLexer lexer;
+    const char *text;
+    size_t length;
+    size_t position;
+    size_t end;
+} FakeLexer;
+
+static void fake_advance(TSLexer *lexer, bool skip) {
+    FakeLexer *fake = (FakeLexer *)lexer;
+    (void)skip;
+    if (fake->position < fake->length) fake->position++;
+    lexer->lookahead = fake->position < fake->length
+                           ? (unsigned char)fake->text[fake->position]
+                           : 0;
+}
+
+static void fake_mark_end(TSLexer *lexer) {
+    FakeLexer *fake = (FakeLexer *)lexer;
+    fake->end = fake->position;
+}
+
+static uint32_t fake_get_column(TSLexer *lexer) {
+    FakeLexer *fake = (FakeLexer *)lexer;
+    size_t start = fake->position;
+    while (start > 0 && fake->text[start - 1] != '\n') start--;
+    return (uint32_t)(fake->position - start);
+}
+
+static bool fake_is_at_included_range_start(const TSLexer *lexer) {
+    (void)lexer;
+    return false;
+}
+
+static bool fake_eof(const TSLexer *lexer) {
+    const FakeLexer *fake = (const FakeLexer *)lexer;
+    return fake->position >= fake->length;
+}
+
+typedef struct {
+    char *text;
+    size_t length;
+} Source;
+
+static bool read_source(const char *path, Source *source) {
+    FILE *file = fopen(path, "rb");
+    if (!file) return false;
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    source->text = malloc(length > 0 ? (size_t)length : 1);
+    source->length = fread(source->text, 1, (size_t)length, file);
+    fclose(file);
+    return true;
+}
+
+static void read_directory(const char *directory, Source **sources,
+                           size_t *count) {
+    DIR *dir = opendir(directory);
+    struct dirent *entry;
+    while (dir && (entry = readdir(dir))) {
+        if (entry->d_name[0] == '.') continue;
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+        *sources = realloc(*sources, (*count + 1) * sizeof(Source));
+        if (read_source(path, &(*sources)[*count])) (*count)++;
+    }
+    if (dir) closedir(dir);
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// The valid symbol sets the COBOL parse states offer the scanner. The
+// extras are valid almost everywhere; EXEC SQL blocks, strings and comment
+// entries only in some states.
+static void valid_sets(bool sets[][TOKEN_COUNT], size_t *count) {
+    static const int tokens[][8] = {
+        {WHITE_SPACES, LINE_PREFIX_COMMENT, LINE_SUFFIX_COMMENT, LINE_COMMENT,
+         COMPILER_DIRECTIVE, -1},
+        {WHITE_SPACES, LINE_PREFIX_COMMENT, LINE_SUFFIX_COMMENT, LINE_COMMENT,
+         COMPILER_DIRECTIVE, EXEC_SQL, -1},
+        {WHITE_SPACES, LINE_PREFIX_COMMENT, LINE_SUFFIX_COMMENT, LINE_COMMENT,
+         COMPILER_DIRECTIVE, MULTILINE_STRING, -1},
+        {COMMENT_ENTRY, -1},
+    };
+    size_t n = sizeof(tokens) / sizeof(tokens[0]);
+    memset(sets, 0, sizeof(bool) * TOKEN_COUNT * n);
+    for (size_t i = 0; i < n; i++) {
+        for (const int *t = tokens[i]; *t >= 0; t++) sets[i][*t] = true;
+    }
+    *count = n;
+}
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+int main(int argc, char **argv) {
+    int rounds = 20;
+    Source *sources = NULL;
+    size_t source_count = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc) {
+            rounds = atoi(argv[++i]);
+            if (rounds < 1) rounds = 1;
+            continue;
+        }
+        sources = realloc(sources, (source_count + 1) * sizeof(Source));
+        if (!read_source(argv[i], &sources[source_count])) {
+            fprintf(stderr, "cannot read %s\n", argv[i]);
+            return 2;
+        }
+        source_count++;
+    }
+    if (source_count == 0) {
+        read_directory(TS_BENCH_ROOT "/tree-sitter-cobol-main/test/cobol85/src",
+                       &sources, &source_count);
+        read_directory(TS_BENCH_ROOT "/tree-sitter-cobol-main/test/custom/src",
+                       &sources, &source_count);
+    }
+    if (source_count == 0) {
+        fprintf(stderr, "no sources\n");
+        return 2;
+    }
+
+    bool sets[4][TOKEN_COUNT];
+    size_t set_count;
+    valid_sets(sets, &set_count);
+
+    FakeLexer fake;
+    fake.lexer.advance = fake_advance;
+    fake.lexer.mark_end = fake_mark_end;
+    fake.lexer.get_column = fake_get_column;
+    fake.lexer.is_at_included_range_start = fake_is_at_included_range_start;
+    fake.lexer.eof = fake_eof;
+
+    uint64_t calls = 0, tokens = 0, bytes = 0;
+    double start = now_seconds();
+    for (int round = 0; round < rounds; round++) {
+        for (size_t s = 0; s < source_count; s++) {
+            const Source *source = &sources[s];
+            fake.text = source->text;
+            fake.length = source->length;
+            bytes += source->length;
+            size_t i = 0;
+            while (i < source->length) {
+                const bool *valid = sets[calls % set_count];
+                fake.position = i;
+                fake.end = i;
+                fake.lexer.lookahead = (unsigned char)source->text[i];
+                bool found = tree_sitter_COBOL_external_scanner_scan(
+                    NULL, &fake.lexer, valid);
+                calls++;
+                if (found && fake.end > i) {
+                    tokens++;
+                    i = fake.end;
+                    continue;
+                }
+                // No token here: skip to the next word or separator, as
+                // the internal lexer would lex the word itself.
+                i++;
+                while (i < source->length && !is_space(source->text[i]) &&
+                       !is_space(source->text[i - 1])) {
+                    i++;
+                }
+            }
+        }
+    }
+    double seconds = now_seconds() - start;
+
+    printf("%llu scan calls (%llu tokens) over %.1f MB in %.3f s\n",
+           (unsigned long long)calls, (unsigned long long)tokens,
+           bytes / 1e6, seconds);
+    printf("%.2f M scan calls/s, %.1f ns per call, %.1f MB/s\n",
+           calls / seconds / 1e6, seconds * 1e9 / calls, bytes / seconds / 1e6);
+
+    for (size_t s = 0; s < source_count; s++) free(sources[s].text);
+    free(sources);
+    return 0;
+}
@@ -0,0 +1,243 @@
+// Measures the CoolGen external scanner alone, in scan calls per second:
+//
+//   coolgen_scanner_bench [--rounds N] [FILE ...]
+//
+// Without files it reads tree-sitter-coolgen/test/yyy. A fake lexer walks
+// each file and, at the start of every word, makes the calls the runtime
+// makes for an external token: deserialize the state of the previous token,
+// scan with one of the valid symbol sets the grammar produces, and serialize
+// the new state. The scanner is linked in directly, so the numbers cover
+// its state handling and lexing without the parser around it.
+//
+// Built by CMakeLists.txt (target coolgen_scanner_bench); it does not need
+// the tree-sitter runtime.
+
+#include "tree_sitter/parser.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+void *tree_sitter_coolgen_external_scanner_create(void);
+void tree_sitter_coolgen_external_scanner_destroy(void *payload);
+bool tree_sitter_coolgen_external_scanner_scan(void *payload, TSLexer *lexer,
+                                               const bool *valid_symbols);
+unsigned tree_sitter_coolgen_external_scanner_serialize(void *payload,
+                                                        char *buffer);
+void tree_sitter_coolgen_external_scanner_deserialize(void *payload,
+                                                      const char *buffer,
+                                                      unsigned length);
+
+enum {
+    NOTE_TERMINATOR,
+    STATEMENT_ID,
+    STATEMENT_PART,
+    BLOCK_ID,
+    BLOCK_TERMINATOR,
+    BOOLAND_BREAK,
+    BOOLOR_BREAK,
+    PARAMETER_BREAK,
+    ERROR_SENTINEL,
+    TOKEN_COUNT,
+};
+
+typedef struct {
+    TSLexer lexer;
+    const char *text;
+    size_t length;
+    size_t position;
+    size_t end;
+} FakeLexer;
+
+static void fake_advance(TSLexer *lexer, bool skip) {
+    FakeLexer *fake = (FakeLexer *)lexer;
+    (void)skip;
+    if (fake->position < fake->length) fake->position++;
+    lexer->lookahead = fake->position < fake->length
+                           ? (unsigned char)fake->text[fake->position]
+                           : 0;
+}
+
+static void fake_mark_end(TSLexer *lexer) {
+    FakeLexer *fake = (FakeLexer *)lexer;
+    fake->end = fake->position;
+}
+
+static uint32_t fake_get_column(TSLexer *lexer) {
+    FakeLexer *fake = (FakeLexer *)lexer;
+    size_t start = fake->position;
+    while (start > 0 && fake->text[start - 1] != '\n') start--;
+    return (uint32_t)(fake->position - start);
+}
+
+static bool fake_is_at_included_range_start(const TSLexer *lexer) {
+    (void)lexer;
+    return false;
+}
+
+static bool fake_eof(const TSLexer *lexer) {
+    const FakeLexer *fake = (const FakeLexer *)lexer;
+    return fake->position >= fake->length;
+}
+
+typedef struct {
+    char *text;
+    size_t length;
+} Source;
+
+static bool read_source(const char *path, Source *source) {
+    FILE *file = fopen(path, "rb");
+    if (!file) return false;
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    source->text = malloc(length > 0 ? (size_t)length : 1);
+    source->length = fread(source->text, 1, (size_t)length, file);
+    fclose(file);
+    return true;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// The valid symbol sets the CoolGen parse states offer the scanner, the last
+// one being error recovery, where every external token is valid.
+static void valid_sets(bool sets[][TOKEN_COUNT], size_t *count) {
+    static const int tokens[][4] = {
+        {STATEMENT_ID, -1},
+        {STATEMENT_PART, BLOCK_ID, -1},
+        {STATEMENT_ID, STATEMENT_PART, BLOCK_TERMINATOR, -1},
+        {BOOLAND_BREAK, BOOLOR_BREAK, -1},
+        {PARAMETER_BREAK, -1},
+    };
+    size_t n = sizeof(tokens) / sizeof(tokens[0]);
+    memset(sets, 0, sizeof(bool) * TOKEN_COUNT * (n + 1));
+    for (size_t i = 0; i < n; i++) {
+        for (const int *t = tokens[i]; *t >= 0; t++) sets[i][*t] = true;
+    }
+    for (int t = 0; t < TOKEN_COUNT; t++) sets[n][t] = true;
+    *count = n + 1;
+}
+
+int main(int argc, char **argv) {
+    int rounds = 20;
+    Source *sources = NULL;
+    size_t source_count = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc) {
+            rounds = atoi(argv[++i]);
+            if (rounds < 1) rounds = 1;
+            continue;
+        }
+        sources = realloc(sources, (source_count + 1) * sizeof(Source));
+        if (!read_source(argv[i], &sources[source_count])) {
+            fprintf(stderr, "cannot read %s\n", argv[i]);
+            return 2;
+        }
+        source_count++;
+    }
+    if (source_count == 0) {
+        const char *directory = TS_BENCH_ROOT "/tree-sitter-coolgen/test/yyy";
+        DIR *dir = opendir(directory);
+        struct dirent *entry;
+        while (dir && (entry = readdir(dir))) {
+            if (entry->d_name[0] == '.') continue;
+            char path[4096];
+            snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+            sources = realloc(sources, (source_count + 1) * sizeof(Source));
+            if (read_source(path, &sources[source_count])) source_count++;
+        }
+        if (dir) closedir(dir);
+    }
+    if (source_count == 0) {
+        fprintf(stderr, "no sources\n");
+        return 2;
+    }
+
+    bool sets[8][TOKEN_COUNT];
+    size_t set_count;
+    valid_sets(sets, &set_count);
+
+    FakeLexer fake;
+    fake.lexer.advance = fake_advance;
+    fake.lexer.mark_end = fake_mark_end;
+    fake.lexer.get_column = fake_get_column;
+    fake.lexer.is_at_included_range_start = fake_is_at_included_range_start;
+    fake.lexer.eof = fake_eof;
+
+    void *scanner = tree_sitter_coolgen_external_scanner_create();
+    char state[TREE_SITTER_SERIALIZATION_BUFFER_SIZE];
+    unsigned state_length = 0;
+    uint64_t calls = 0, tokens = 0, bytes = 0;
+    double start = now_seconds();
+    for (int round = 0; round < rounds; round++) {
+        for (size_t s = 0; s < source_count; s++) {
+            const Source *source = &sources[s];
+            fake.text = source->text;
+            fake.length = source->length;
+            tree_sitter_coolgen_external_scanner_deserialize(scanner, NULL, 0);
+            bytes += source->length;
+            for (size_t i = 0; i < source->length; i++) {
+                unsigned char c = (unsigned char)source->text[i];
+                unsigned char previous =
+                    i ? (unsigned char)source->text[i - 1] : ' ';
+                bool word_start = c > ' ' && (previous == ' ' || previous == '\n');
+                if (!word_start) continue;
+
+                const bool *valid = sets[calls % set_count];
+                fake.position = i;
+                fake.end = i;
+                fake.lexer.lookahead = c;
+                tree_sitter_coolgen_external_scanner_deserialize(
+                    scanner, state, state_length);
+                if (tree_sitter_coolgen_external_scanner_scan(
+                        scanner, &fake.lexer, valid)) {
+                    tokens++;
+                }
+                state_length = tree_sitter_coolgen_external_scanner_serialize(
+                    scanner, state);
+                calls++;
+            }
+        }
+    }
+    double seconds = now_seconds() - start;
+
+    // The state handling on its own: the deserialize/serialize pair around
+    // every external scan, and the create/destroy of every parser.
+    const uint64_t round_trips = 20000000;
+    start = now_seconds();
+    for (uint64_t i = 0; i < round_trips; i++) {
+        tree_sitter_coolgen_external_scanner_deserialize(
+            scanner, state, i % 64 ? state_length : 0);
+        state_length =
+            tree_sitter_coolgen_external_scanner_serialize(scanner, state);
+    }
+    double round_trip_seconds = now_seconds() - start;
+    tree_sitter_coolgen_external_scanner_destroy(scanner);
+
+    const uint64_t creates = 2000000;
+    start = now_seconds();
+    for (uint64_t i = 0; i < creates; i++) {
+        tree_sitter_coolgen_external_scanner_destroy(
+            tree_sitter_coolgen_external_scanner_create());
+    }
+    double create_seconds = now_seconds() - start;
+
+    printf("%llu scan calls (%llu tokens) over %.1f MB in %.3f s\n",
+           (unsigned long long)calls, (unsigned long long)tokens,
+           bytes / 1e6, seconds);
+    printf("%.2f M scan calls/s, %.1f ns per call\n", calls / seconds / 1e6,
+           seconds * 1e9 / calls);
+    printf("%.1f ns per deserialize/serialize, %.1f ns per create/destroy\n",
+           round_trip_seconds * 1e9 / round_trips,
+           create_seconds * 1e9 / creates);
+
+    for (size_t s = 0; s < source_count; s++) free(sources[s].text);
+    free(sources);
+    return 0;
+}
@@ -0,0 +1,301 @@
+// Parses whole corpora in one process and reports throughput, per-file
+// latency percentiles, node and error counts and peak RSS:
+//
+//   corpus_bench [--rounds N] [--json] [--arena] [--skeleton] [--cache DIR]
+//                [LANGUAGE=DIR ...]
+//
+// Without corpora it runs the COBOL test/cobol85/src, test/custom/src and
+// test/ocesql/src trees and CoolGen's test/yyy. Directories are walked
+// recursively and every file is read into memory before the clock starts,
+// so the numbers cover the parser and scanner alone, on a single thread.
+// --json prints one machine-readable object instead of the table, for
+// tracking regressions. --arena parses with ParseOptions::arena; a run
+// without it gives the gain, and the two peak RSS figures what the arena's
+// kept block costs.
+// --skeleton runs the skeleton extractor of the grammars that have one
+// instead of the parser, and counts landmarks as nodes; comparing it with a
+// run without the flag gives the cost of a full parse for an outline.
+// --cache serves the parses from a ParseCache under DIR: with a cold cache
+// the first round parses and stores every file and the others load them, so
+// the p50 is the cost of a hit and the max that of a miss.
+//
+// Built by CMakeLists.txt (target corpus_bench) with every grammar and the
+// tree-sitter runtime linked in statically.
+
+#include "batch_parse.h"
+#include "languages.h"
+#include "parse_cache.h"
+
+#include <dirent.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace ts_native;
+
+namespace {
+
+struct Corpus {
+  std::string language;
+  std::string directory;
+};
+
+struct Stats {
+  Corpus corpus;
+  size_t files = 0;
+  uint64_t bytes = 0;
+  uint64_t nodes = 0;
+  uint64_t errors = 0;
+  uint64_t missing = 0;
+  size_t files_with_errors = 0;
+  double seconds = 0;
+  double p50_ms = 0;
+  double p99_ms = 0;
+  double max_ms = 0;
+  long peak_rss_kb = 0;
+};
+
+void list_files(const std::string &directory, std::vector<std::string> *paths) {
+  DIR *dir = opendir(directory.c_str());
+  if (!dir) return;
+  while (struct dirent *entry = readdir(dir)) {
+    if (entry->d_name[0] == '.') continue;
+    std::string path = directory + "/" + entry->d_name;
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) continue;
+    if (S_ISDIR(st.st_mode)) {
+      list_files(path, paths);
+    } else if (S_ISREG(st.st_mode)) {
+      paths->push_back(path);
+    }
+  }
+  closedir(dir);
+}
+
+long peak_rss_kb() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;  // kilobytes on Linux
+}
+
+double percentile(const std::vector<double> &sorted, double p) {
+  if (sorted.empty()) return 0;
+  size_t i = static_cast<size_t>(sorted.size() * p);
+  return sorted[std::min(i, sorted.size() - 1)];
+}
+
+bool run(const Corpus &corpus, int rounds, bool arena, bool skeleton,
+         const std::string &cache_directory, Stats *stats) {
+  stats->corpus = corpus;
+  const TSLanguage *language = ts_languages_get(corpus.language.c_str());
+  if (!language) {
+    fprintf(stderr, "%s: not built into this benchmark\n",
+            corpus.language.c_str());
+    return false;
+  }
+  Grammar grammar = {corpus.language.c_str(), language, nullptr, false,
+                     nullptr, false, nullptr, false};
+  if (corpus.language == "COBOL") {
+    grammar.extract_skeleton = extract_cobol_skeleton;
+  } else if (corpus.language == "coolgen") {
+    grammar.extract_skeleton = extract_coolgen_skeleton;
+  }
+  if (skeleton && !grammar.extract_skeleton) {
+    fprintf(stderr, "%s: no skeleton extractor\n", corpus.language.c_str());
+    return false;
+  }
+
+  std::vector<std::string> paths;
+  list_files(corpus.directory, &paths);
+  std::sort(paths.begin(), paths.end());
+  if (paths.empty()) {
+    fprintf(stderr, "%s: no files\n", corpus.directory.c_str());
+    return false;
+  }
+
+  std::vector<std::string> sources(paths.size());
+  for (size_t i = 0; i < paths.size(); i++) {
+    std::string error;
+    if (!read_file(paths[i], &sources[i], &error)) {
+      fprintf(stderr, "%s\n", error.c_str());
+      return false;
+    }
+  }
+
+  ParseOptions options;
+  options.arena = arena;
+  options.skeleton = skeleton;
+  if (!cache_directory.empty()) {
+    std::string error;
+    options.cache = ParseCache::Get(cache_directory, language, &error);
+    if (!options.cache) {
+      fprintf(stderr, "%s\n", error.c_str());
+      return false;
+    }
+  }
+  std::vector<double> latencies;
+  latencies.reserve(paths.size() * rounds);
+  for (int round = 0; round < rounds; round++) {
+    for (size_t i = 0; i < sources.size(); i++) {
+      ParseResult result;
+      parse_source(grammar, options, sources[i].data(),
+                   static_cast<uint32_t>(sources[i].size()), &result);
+      latencies.push_back(result.parse_ms);
+      stats->seconds += result.parse_ms / 1000;
+      stats->bytes += result.bytes;
+      // Counts are the same every round; report them once.
+      if (round == 0) {
+        stats->nodes += skeleton ? result.skeleton.size() : result.node_count;
+        stats->errors += result.error_count;
+        stats->missing += result.missing_count;
+        if (result.error_count > 0 || result.missing_count > 0) {
+          stats->files_with_errors++;
+        }
+      }
+    }
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+  stats->files = paths.size();
+  stats->p50_ms = percentile(latencies, 0.5);
+  stats->p99_ms = percentile(latencies, 0.99);
+  stats->max_ms = latencies.back();
+  stats->peak_rss_kb = peak_rss_kb();
+  return true;
+}
+
+std::string json_string(const std::string &text) {
+  std::string out = "\"";
+  for (unsigned char c : text) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (c < 0x20) {
+      char escape[8];
+      snprintf(escape, sizeof(escape), "\\u%04x", c);
+      out += escape;
+    } else {
+      out += c;
+    }
+  }
+  return out + "\"";
+}
+
+double mb_per_second(const Stats &stats) {
+  return stats.seconds > 0 ? stats.bytes / stats.seconds / 1e6 : 0;
+}
+
+void print_json(const std::vector<Stats> &all, int rounds) {
+  printf("{\n  \"rounds\": %d,\n  \"corpora\": [", rounds);
+  for (size_t i = 0; i < all.size(); i++) {
+    const Stats &s = all[i];
+    printf("%s\n    {\"language\": %s, \"directory\": %s, \"files\": %zu, "
+           "\"bytes\": %llu, \"seconds\": %.6f, \"mb_per_second\": %.3f, "
+           "\"p50_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f, "
+           "\"nodes\": %llu, \"errors\": %llu, \"missing\": %llu, "
+           "\"files_with_errors\": %zu, \"peak_rss_kb\": %ld}",
+           i ? "," : "", json_string(s.corpus.language).c_str(),
+           json_string(s.corpus.directory).c_str(), s.files,
+           static_cast<unsigned long long>(s.bytes), s.seconds,
+           mb_per_second(s), s.p50_ms, s.p99_ms, s.max_ms,
+           static_cast<unsigned long long>(s.nodes),
+           static_cast<unsigned long long>(s.errors),
+           static_cast<unsigned long long>(s.missing), s.files_with_errors,
+           s.peak_rss_kb);
+  }
+  printf("\n  ],\n  \"peak_rss_kb\": %ld\n}\n", peak_rss_kb());
+}
+
+void print_table(const std::vector<Stats> &all, int rounds) {
+  printf("%d rounds, single thread\n\n", rounds);
+  printf("%-8s %-40s %6s %9s %8s %8s %8s %9s %7s\n", "language", "directory",
+         "files", "MB/s", "p50 ms", "p99 ms", "max ms", "nodes", "errors");
+  for (const Stats &s : all) {
+    std::string directory = s.corpus.directory;
+    if (directory.size() > 40) {
+      directory = "..." + directory.substr(directory.size() - 37);
+    }
+    printf("%-8s %-40s %6zu %9.2f %8.3f %8.3f %8.3f %9llu %7llu\n",
+           s.corpus.language.c_str(), directory.c_str(), s.files,
+           mb_per_second(s), s.p50_ms, s.p99_ms, s.max_ms,
+           static_cast<unsigned long long>(s.nodes),
+           static_cast<unsigned long long>(s.errors + s.missing));
+  }
+  printf("\npeak RSS %.1f MB\n", peak_rss_kb() / 1024.0);
+}
+
+void usage() {
+  fprintf(stderr,
+          "usage: corpus_bench [--rounds N] [--json] [--arena] [--skeleton]\n"
+          "                    [--cache DIR] [LANGUAGE=DIR ...]\n"
+          "languages:");
+  for (size_t i = 0; i < ts_languages_count(); i++) {
+    fprintf(stderr, " %s", ts_languages_name(i));
+  }
+  fprintf(stderr, "\n");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  int rounds = 5;
+  bool json = false;
+  bool arena = false;
+  bool skeleton = false;
+  std::string cache_directory;
+  std::vector<Corpus> corpora;
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    const char *equals = strchr(arg, '=');
+    if (strcmp(arg, "--rounds") == 0 && i + 1 < argc) {
+      rounds = std::max(1, atoi(argv[++i]));
+    } else if (strcmp(arg, "--json") == 0) {
+      json = true;
+    } else if (strcmp(arg, "--arena") == 0) {
+      arena = true;
+    } else if (strcmp(arg, "--skeleton") == 0) {
+      skeleton = true;
+    } else if (strcmp(arg, "--cache") == 0 && i + 1 < argc) {
+      cache_directory = argv[++i];
+    } else if (arg[0] != '-' && equals) {
+      corpora.push_back({std::string(arg, equals), equals + 1});
+    } else {
+      usage();
+      return 2;
+    }
+  }
+
+  if (corpora.empty()) {
+    const std::string root = TS_BENCH_ROOT;
+    corpora = {
+        {"COBOL", root + "/tree-sitter-cobol-main/test/cobol85/src"},
+        {"COBOL", root + "/tree-sitter-cobol-main/test/custom/src"},
+        {"COBOL", root + "/tree-sitter-cobol-main/test/ocesql/src"},
+        {"coolgen", root + "/tree-sitter-coolgen/test/yyy"},
+    };
+  }
+
+  std::vector<Stats> all;
+  bool ok = true;
+  for (const Corpus &corpus : corpora) {
+    Stats stats;
+    if (run(corpus, rounds, arena, skeleton, cache_directory, &stats)) {
+      all.push_back(stats);
+    } else {
+      ok = false;
+    }
+  }
+
+  if (json) {
+    print_json(all, rounds);
+  } else {
+    print_table(all, rounds);
+  }
+  return ok ? 0 : 1;
+}
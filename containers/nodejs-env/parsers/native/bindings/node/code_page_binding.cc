@@ -0,0 +1,71 @@
+#include "native_binding.h"
+#include "code_page.h"
+
+#include <cctype>
+#include <vector>
+
+using namespace v8;
+
+namespace ts_native {
+
+namespace {
+
+bool IsUtf8(std::string name) {
+  for (char &c : name) c = tolower(static_cast<unsigned char>(c));
+  return name == "utf8" || name == "utf-8";
+}
+
+// decode(buffer, encoding): the text of a code-page Buffer as a string with
+// one UTF-16 unit per byte, so byte offsets from a parse index it directly.
+NAN_METHOD(Decode) {
+  if (!info[0]->IsArrayBufferView()) {
+    Nan::ThrowTypeError("First argument must be a Buffer or typed array");
+    return;
+  }
+  const CodePage *code_page = nullptr;
+  if (!info[1]->IsString() ||
+      !(code_page = find_code_page(*Nan::Utf8String(info[1])))) {
+    Nan::ThrowTypeError("Second argument must be a code page name");
+    return;
+  }
+
+  Local<ArrayBufferView> view = info[0].As<ArrayBufferView>();
+  std::vector<uint16_t> units(view->ByteLength());
+  if (!units.empty()) {
+    const unsigned char *bytes =
+        static_cast<const unsigned char *>(view->Buffer()->Data()) +
+        view->ByteOffset();
+    for (size_t i = 0; i < units.size(); i++) {
+      units[i] = code_page->to_unicode[bytes[i]];
+    }
+  }
+  Local<String> text;
+  if (String::NewFromTwoByte(info.GetIsolate(), units.data(),
+                             NewStringType::kNormal,
+                             static_cast<int>(units.size()))
+          .ToLocal(&text)) {
+    info.GetReturnValue().Set(text);
+  }
+}
+
+}  // namespace
+
+bool GetEncodingOption(Local<Value> options, const CodePage **out) {
+  std::string name;
+  *out = nullptr;
+  if (!GetStringOption(options, "encoding", &name) || IsUtf8(name)) {
+    return true;
+  }
+  *out = find_code_page(name);
+  if (!*out) {
+    Nan::ThrowTypeError(("Unsupported encoding " + name).c_str());
+    return false;
+  }
+  return true;
+}
+
+void InitCodePages(Local<Object> instance, AddonData *data) {
+  SetMethod(instance, "decode", Decode, data);
+}
+
+}  // namespace ts_native
@@ -0,0 +1,49 @@
+#include "native_binding.h"
+#include "flat_tree.h"
+
+#include <tree_sitter/api.h>
+
+using namespace v8;
+
+namespace ts_native {
+
+Local<ArrayBuffer> NewFlatTreeBuffer(FlatTree *flat) {
+  size_t size = flat->size();
+  // The buffer keeps a reference to the block, which may be a mapped cache
+  // entry rather than malloc'd memory.
+  auto *owner = new std::shared_ptr<uint8_t>(flat->release());
+  std::unique_ptr<BackingStore> store = ArrayBuffer::NewBackingStore(
+      owner->get(), size,
+      [](void *, size_t, void *owner) {
+        delete static_cast<std::shared_ptr<uint8_t> *>(owner);
+      },
+      owner);
+  return ArrayBuffer::New(Isolate::GetCurrent(), std::move(store));
+}
+
+// Name tables for the ids stored in the flat `symbol` and `field` columns,
+// so JS can decode them without asking the addon per node.
+void InitFlatTree(Local<Object> instance, AddonData *data) {
+  const TSLanguage *language = data->language();
+
+  uint32_t symbol_count = ts_language_symbol_count(language);
+  Local<Array> symbols = Nan::New<Array>(symbol_count);
+  for (uint32_t i = 0; i < symbol_count; i++) {
+    const char *name = ts_language_symbol_name(language, i);
+    Nan::Set(symbols, i, Nan::New(name ? name : "").ToLocalChecked());
+  }
+
+  // Field ids start at 1; 0 means "no field".
+  uint32_t field_count = ts_language_field_count(language);
+  Local<Array> fields = Nan::New<Array>(field_count + 1);
+  Nan::Set(fields, 0, Nan::Null());
+  for (uint32_t i = 1; i <= field_count; i++) {
+    const char *name = ts_language_field_name_for_id(language, i);
+    Nan::Set(fields, i, Nan::New(name ? name : "").ToLocalChecked());
+  }
+
+  Nan::Set(instance, Nan::New("symbolNames").ToLocalChecked(), symbols);
+  Nan::Set(instance, Nan::New("fieldNames").ToLocalChecked(), fields);
+}
+
+}  // namespace ts_native
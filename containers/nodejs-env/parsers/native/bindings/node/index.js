@@ -0,0 +1,231 @@
+const os = require("os");
+
+function defaultConcurrency() {
+  const poolSize = Number(process.env.UV_THREADPOOL_SIZE) || 4;
+  return Math.max(1, Math.min(poolSize, os.cpus().length));
+}
+
+const FLAT_TREE_MAGIC = 0x4c465354;
+const FLAT_TREE_VERSION = 1;
+
+// Wraps the ArrayBuffer produced by parseFiles(..., { flat: true }) in typed
+// array views, one per column, without copying. Mirrors native/src/flat_tree.h.
+function readFlatTree(buffer) {
+  const header = new Uint32Array(buffer, 0, 4);
+  if (header[0] !== FLAT_TREE_MAGIC || header[1] !== FLAT_TREE_VERSION) {
+    throw new Error("Not a flat tree buffer");
+  }
+  const nodeCount = header[2];
+  let offset = header.byteLength;
+  const column = (Type) => {
+    const view = new Type(buffer, offset, nodeCount);
+    offset += view.byteLength;
+    return view;
+  };
+  return {
+    nodeCount,
+    startByte: column(Uint32Array),
+    endByte: column(Uint32Array),
+    startRow: column(Uint32Array),
+    startColumn: column(Uint32Array),
+    endRow: column(Uint32Array),
+    endColumn: column(Uint32Array),
+    parent: column(Int32Array),
+    symbol: column(Uint16Array),
+    field: column(Uint16Array),
+    flags: column(Uint8Array),
+  };
+}
+
+// Maps an offset in copybook-expanded text back to { file, offset } through
+// the `copybooks` of a parseFiles/preprocessFiles result. Mirrors
+// ExpandedSource::original_position in native/src/copybook.h.
+function originalPosition(copybooks, offset) {
+  const map = copybooks.sourceMap;
+  let low = 0;
+  let high = map.length / 5;
+  while (low < high) {
+    const mid = (low + high) >>> 1;
+    if (map[mid * 5] <= offset) low = mid + 1;
+    else high = mid;
+  }
+  if (low === 0) return null;
+  const i = (low - 1) * 5;
+  const [expandedStart, expandedLength, file, originalStart, originalLength] =
+    map.subarray(i, i + 5);
+  if (offset >= expandedStart + expandedLength) return null;
+  return {
+    file: copybooks.files[file],
+    offset: expandedLength === originalLength
+      ? originalStart + offset - expandedStart
+      : originalStart,
+  };
+}
+
+// Returns (start, end) => the text between two byte offsets of `source`,
+// a UTF-8 string or Buffer, or for code-page sources the string decode()
+// returns, whose indices are the byte offsets.
+function textSlicer(source, encoding) {
+  if (/^utf-?8$/i.test(encoding)) {
+    const bytes = Buffer.isBuffer(source) ? source : Buffer.from(source, "utf8");
+    return (start, end) => bytes.toString("utf8", start, end);
+  }
+  return (start, end) => source.slice(start, end);
+}
+
+const DATA_FLOW_RELATIONS = ["comesFrom", "computedFrom"];
+
+// Turns the `dataFlow` of a parseFiles result into what GraphCodeBERT's
+// extract_dataflow returns: the code tokens, tree_to_token_index as
+// [[startRow, startColumn], [endRow, endColumn]] pairs and the DFG as
+// [code, index, relation, sourceCodes, sourceIndices] tuples. `source` is the
+// parsed text: a UTF-8 string or Buffer, or for code-page sources the string
+// decode() returns, whose indices are the byte offsets. Mirrors
+// native/src/data_flow.h.
+function dataFlowGraph(dataFlow, source, encoding = "utf8") {
+  const slice = textSlicer(source, encoding);
+  const { tokens, edges, sources } = dataFlow;
+  const codeTokens = [];
+  const treeToTokenIndex = [];
+  for (let i = 0; i < tokens.length; i += 6) {
+    codeTokens.push(slice(tokens[i], tokens[i + 1]));
+    treeToTokenIndex.push([[tokens[i + 2], tokens[i + 3]], [tokens[i + 4], tokens[i + 5]]]);
+  }
+  const dfg = [];
+  for (let i = 0; i < edges.length; i += 5) {
+    const [token, , relation, firstSource, sourceCount] = edges.subarray(i, i + 5);
+    const from = Array.from(sources.subarray(firstSource, firstSource + sourceCount));
+    dfg.push([codeTokens[token], token, DATA_FLOW_RELATIONS[relation],
+      from.map((index) => codeTokens[index]), from]);
+  }
+  return { codeTokens, treeToTokenIndex, dfg };
+}
+
+const SKELETON_KINDS = [
+  "program", "division", "section", "paragraph", "copy", "call", "endProgram",
+  "importView", "exportView", "entityActionView", "localView", "use", "date",
+  "time", "search", "source",
+];
+
+// Turns the `skeleton` of a parseFiles result into
+// { kind, name, startByte, endByte, row } objects, taking names from the
+// parsed `source` as dataFlowGraph does. Mirrors native/src/skeleton.h.
+function readSkeleton(skeleton, source, encoding = "utf8") {
+  const slice = textSlicer(source, encoding);
+  const landmarks = [];
+  for (let i = 0; i < skeleton.length; i += 6) {
+    const [kind, startByte, endByte, row, nameStart, nameEnd] =
+      skeleton.subarray(i, i + 6);
+    landmarks.push({
+      kind: SKELETON_KINDS[kind],
+      name: slice(nameStart, nameEnd),
+      startByte,
+      endByte,
+      row,
+    });
+  }
+  return landmarks;
+}
+
+const NO_DEFINITION = 0xffffffff;
+
+// Turns the `embeddedSql` of a parseFiles result into
+// { startByte, endByte, row, sql, hostVariables } objects, one per EXEC SQL
+// block. Host variables are { name, startByte, endByte, row, definition },
+// `definition` being the { startByte, endByte } of the data name they refer
+// to, or null. Names are taken from the parsed `source` as dataFlowGraph
+// does. Mirrors native/src/embedded_sql.h.
+function readEmbeddedSql(embeddedSql, source, encoding = "utf8") {
+  const slice = textSlicer(source, encoding);
+  const { blocks, sql, hostVariables } = embeddedSql;
+  const result = [];
+  for (let i = 0; i < blocks.length; i += 5) {
+    const [startByte, endByte, row, first, count] = blocks.subarray(i, i + 5);
+    const variables = [];
+    for (let v = first; v < first + count; v++) {
+      const [, start, end, variableRow, definitionStart, definitionEnd] =
+        hostVariables.subarray(v * 6, v * 6 + 6);
+      variables.push({
+        name: slice(start, end),
+        startByte: start,
+        endByte: end,
+        row: variableRow,
+        definition: definitionStart === NO_DEFINITION
+          ? null
+          : { startByte: definitionStart, endByte: definitionEnd },
+      });
+    }
+    result.push({ startByte, endByte, row, sql: sql[i / 5], hostVariables: variables });
+  }
+  return result;
+}
+
+// Parses the SQL of every block of an `embeddedSql` result with another
+// grammar addon, such as an SQL grammar built on this native layer, on the
+// threadpool. Resolves with one parseBuffers result per block, in order.
+function parseEmbeddedSql(embeddedSql, sqlLanguage, options = {}) {
+  return sqlLanguage.parseBuffers(
+    embeddedSql.sql.map((text) => Buffer.from(text, "utf8")), options);
+}
+
+// Adds the promise-based native API to a grammar's exported Language object.
+module.exports = function decorate(language) {
+  const promisify = (nativeMethod) => (sources, options = {}) => {
+    const nativeOptions = Object.assign({
+      concurrency: defaultConcurrency(),
+    }, options);
+    if (nativeOptions.query && typeof nativeOptions.query === "object") {
+      nativeOptions.query = nativeOptions.query.source;
+    }
+    return new Promise((resolve, reject) => {
+      nativeMethod(Array.from(sources), nativeOptions, (error, results) => {
+        if (error) reject(error);
+        else resolve(results);
+      });
+    });
+  };
+
+  language.parseFiles = promisify(language._parseFiles);
+
+  // Parses Buffers, typed arrays or ArrayBuffers in place, without copying
+  // them or turning them into strings. Takes the parseFiles options except
+  // copybooks; results have no `path` and come back in the same order.
+  language.parseBuffers = promisify(language._parseBuffers);
+
+  // Expands COPY statements without parsing; results carry the expanded
+  // `text` beside `copybooks`.
+  language.preprocessFiles = function preprocessFiles(paths, options = {}) {
+    return language.parseFiles(paths, Object.assign({
+      copybooks: {},
+    }, options, { parse: false }));
+  };
+
+  // Compiles a query, throwing a SyntaxError if it or one of its predicates
+  // is invalid, and returns { source, captureNames, patternCount }. Either it
+  // or its source can be the `query` option of parseFiles and parseBuffers.
+  language.compileQuery = (source) => language._compileQuery(source);
+
+  // Runs a query over many files on the threadpool; predicates are evaluated
+  // natively. Resolves with { captureNames, results }, each result carrying
+  // `query: { matches, captures }`.
+  language.queryFiles = async function queryFiles(paths, query, options = {}) {
+    const compiled = typeof query === "string" ? language.compileQuery(query) : query;
+    const results = await language.parseFiles(paths, Object.assign({}, options, {
+      query: compiled.source,
+    }));
+    return { captureNames: compiled.captureNames, results };
+  };
+
+  language.readFlatTree = readFlatTree;
+  language.originalPosition = originalPosition;
+  language.dataFlowGraph = dataFlowGraph;
+  language.readSkeleton = readSkeleton;
+  language.readEmbeddedSql = readEmbeddedSql;
+  language.parseEmbeddedSql = parseEmbeddedSql;
+  language.FLAT_NAMED = 1 << 0;
+  language.FLAT_MISSING = 1 << 1;
+  language.FLAT_EXTRA = 1 << 2;
+  language.FLAT_HAS_ERROR = 1 << 3;
+
+  return language;
+};
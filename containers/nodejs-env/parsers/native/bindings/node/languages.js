@@ -0,0 +1,40 @@
+// Languages from my-languages.so (see CMakeLists.txt), looked up by grammar
+// name as languages.py does for Python:
+//
+//   const { language } = require("./native/bindings/node/languages");
+//   parser.setLanguage(language("coolgen"));
+//
+// The registry addon, my-languages.node, and the library with it are only
+// loaded on the first lookup, and only the grammars looked up are ever
+// touched, however many the library has. The grammar packages'
+// parseFiles and the other native batch methods are not on these languages.
+const path = require("path");
+
+const ADDON_PATH = process.env.TS_LANGUAGES_ADDON ||
+  path.join(__dirname, "..", "..", "..", "my-languages.node");
+
+let registry = null;
+const languages = new Map();
+
+function load() {
+  if (registry === null) registry = require(ADDON_PATH);
+  return registry;
+}
+
+function names() {
+  return load().names();
+}
+
+function language(name) {
+  const key = name.toLowerCase();
+  if (!languages.has(key)) {
+    const found = load().get(name);
+    if (found === undefined) {
+      throw new Error(`${name} is not in ${ADDON_PATH} (has: ${names().join(", ")})`);
+    }
+    languages.set(key, found);
+  }
+  return languages.get(key);
+}
+
+module.exports = { language, names };
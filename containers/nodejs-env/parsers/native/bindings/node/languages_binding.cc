@@ -0,0 +1,62 @@
+// my-languages.node: the registry of my-languages.so (languages.h) for Node.
+// CMakeLists.txt builds it next to the library, which it links against;
+// native/bindings/node/languages.js loads it on the first lookup.
+
+#include <nan.h>
+#include <node.h>
+
+#include "languages.h"
+
+using namespace v8;
+
+namespace {
+
+NAN_METHOD(New) {}
+
+// get(name): the language wrapped as the grammar addons' binding.cc wrap
+// theirs, so a Parser takes either, or undefined for a name the library
+// was not built with.
+NAN_METHOD(Get) {
+  if (!info[0]->IsString()) {
+    Nan::ThrowTypeError("First argument must be a language name");
+    return;
+  }
+  Nan::Utf8String name(info[0]);
+  const TSLanguage *language = ts_languages_get(*name);
+  if (!language) return;
+
+  Local<Function> constructor = info.Data().As<Function>();
+  Local<Object> instance = Nan::NewInstance(constructor).ToLocalChecked();
+  Nan::SetInternalFieldPointer(instance, 0, const_cast<TSLanguage *>(language));
+  Nan::Set(instance, Nan::New("name").ToLocalChecked(), info[0]);
+  info.GetReturnValue().Set(instance);
+}
+
+// names(): the languages of the library, in build order.
+NAN_METHOD(Names) {
+  size_t count = ts_languages_count();
+  Local<Array> names = Nan::New<Array>(count);
+  for (size_t i = 0; i < count; i++) {
+    Nan::Set(names, i, Nan::New(ts_languages_name(i)).ToLocalChecked());
+  }
+  info.GetReturnValue().Set(names);
+}
+
+void Init(Local<Object> exports) {
+  Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(New);
+  tpl->SetClassName(Nan::New("Language").ToLocalChecked());
+  tpl->InstanceTemplate()->SetInternalFieldCount(1);
+  Local<Function> constructor = Nan::GetFunction(tpl).ToLocalChecked();
+
+  Nan::Set(exports, Nan::New("get").ToLocalChecked(),
+           Nan::GetFunction(Nan::New<FunctionTemplate>(Get, constructor))
+               .ToLocalChecked());
+  Nan::Set(exports, Nan::New("names").ToLocalChecked(),
+           Nan::GetFunction(Nan::New<FunctionTemplate>(Names))
+               .ToLocalChecked());
+}
+
+}  // namespace
+
+// Context-aware, like the grammar addons.
+NODE_MODULE_INIT() { Init(exports); }
@@ -0,0 +1,88 @@
+#include "native_binding.h"
+
+#include <node.h>
+
+using namespace v8;
+
+namespace ts_native {
+
+AddonData *AddonData::New(Isolate *isolate, const Grammar *grammar) {
+  AddonData *data = new AddonData(grammar);
+  node::AddEnvironmentCleanupHook(isolate, Delete, data);
+  return data;
+}
+
+void AddonData::Delete(void *data) { delete static_cast<AddonData *>(data); }
+
+void InitLanguage(Local<Object> instance, AddonData *data) {
+  InitParseFiles(instance, data);
+  InitFlatTree(instance, data);
+  InitCodePages(instance, data);
+  InitQuery(instance, data);
+}
+
+bool GetStringArray(Local<Value> value, std::vector<std::string> *out) {
+  if (!value->IsArray()) return false;
+  Local<Array> array = value.As<Array>();
+  out->reserve(array->Length());
+  for (uint32_t i = 0; i < array->Length(); i++) {
+    Local<Value> element = Nan::Get(array, i).ToLocalChecked();
+    if (!element->IsString()) return false;
+    out->emplace_back(*Nan::Utf8String(element));
+  }
+  return true;
+}
+
+static MaybeLocal<Value> GetOption(Local<Value> options, const char *name) {
+  if (!options->IsObject()) return MaybeLocal<Value>();
+  Local<Value> value;
+  if (!Nan::Get(options.As<Object>(), Nan::New(name).ToLocalChecked())
+           .ToLocal(&value) ||
+      value->IsUndefined()) {
+    return MaybeLocal<Value>();
+  }
+  return value;
+}
+
+double GetNumberOption(Local<Value> options, const char *name,
+                       double fallback) {
+  Local<Value> value;
+  if (!GetOption(options, name).ToLocal(&value)) return fallback;
+  return Nan::To<double>(value).FromMaybe(fallback);
+}
+
+bool GetBoolOption(Local<Value> options, const char *name, bool fallback) {
+  Local<Value> value;
+  if (!GetOption(options, name).ToLocal(&value)) return fallback;
+  return Nan::To<bool>(value).FromMaybe(fallback);
+}
+
+bool GetObjectOption(Local<Value> options, const char *name,
+                     Local<Object> *out) {
+  Local<Value> value;
+  if (!GetOption(options, name).ToLocal(&value) || !value->IsObject()) {
+    return false;
+  }
+  *out = value.As<Object>();
+  return true;
+}
+
+bool GetStringOption(Local<Value> options, const char *name,
+                     std::string *out) {
+  Local<Value> value;
+  if (!GetOption(options, name).ToLocal(&value) || !value->IsString()) {
+    return false;
+  }
+  *out = *Nan::Utf8String(value);
+  return true;
+}
+
+void SetMethod(Local<Object> instance, const char *name,
+               Nan::FunctionCallback method, AddonData *data) {
+  Local<FunctionTemplate> tpl =
+      Nan::New<FunctionTemplate>(method, Nan::New<External>(data));
+  Nan::Set(instance, Nan::New(name).ToLocalChecked(),
+           Nan::GetFunction(tpl).ToLocalChecked());
+}
+
+}  // namespace ts_native
@@ -0,0 +1,80 @@
+#ifndef TS_NATIVE_NATIVE_BINDING_H_
+#define TS_NATIVE_NATIVE_BINDING_H_
+
+#include <nan.h>
+
+#include <string>
+#include <vector>
+
+#include "grammar.h"
+
+namespace ts_native {
+
+// Per-isolate instance data of a grammar addon. The addons are context-aware,
+// so every worker_threads Worker that loads one gets its own AddonData, freed
+// by an environment cleanup hook when that Worker exits. The Grammar and
+// TSLanguage it points to are static and shared by the whole process.
+class AddonData {
+ public:
+  static AddonData *New(v8::Isolate *isolate, const Grammar *grammar);
+
+  const Grammar *grammar() const { return grammar_; }
+  const TSLanguage *language() const { return grammar_->language; }
+
+ private:
+  explicit AddonData(const Grammar *grammar) : grammar_(grammar) {}
+
+  static void Delete(void *data);
+
+  const Grammar *grammar_;
+};
+
+// Attaches the native methods shared by every grammar addon to the exported
+// `Language` object. The JS side (native/bindings/node/index.js) wraps them
+// in the public promise-based API.
+void InitLanguage(v8::Local<v8::Object> instance, AddonData *data);
+
+void InitParseFiles(v8::Local<v8::Object> instance, AddonData *data);
+void InitFlatTree(v8::Local<v8::Object> instance, AddonData *data);
+void InitCodePages(v8::Local<v8::Object> instance, AddonData *data);
+void InitQuery(v8::Local<v8::Object> instance, AddonData *data);
+
+class FlatTree;
+class Query;
+struct CodePage;
+
+// Reads an `encoding` option: "utf8" (the default) gives null, a code page
+// name its CodePage. Throws a TypeError and returns false for anything else.
+bool GetEncodingOption(v8::Local<v8::Value> options, const CodePage **out);
+
+// Reads a `query` option: no query gives null, a query string the Query it
+// compiles to for `grammar`. Throws a SyntaxError and returns false if it
+// does not compile.
+bool GetQueryOption(v8::Local<v8::Value> options, const Grammar *grammar,
+                    const Query **out);
+
+// Wraps the columns of `flat` in an ArrayBuffer without copying; the buffer
+// takes ownership and can be transferred to another thread.
+v8::Local<v8::ArrayBuffer> NewFlatTreeBuffer(FlatTree *flat);
+
+// Helpers for reading the plain option objects passed down from index.js.
+bool GetStringArray(v8::Local<v8::Value> value, std::vector<std::string> *out);
+double GetNumberOption(v8::Local<v8::Value> options, const char *name,
+                       double fallback);
+bool GetBoolOption(v8::Local<v8::Value> options, const char *name,
+                   bool fallback);
+bool GetObjectOption(v8::Local<v8::Value> options, const char *name,
+                     v8::Local<v8::Object> *out);
+bool GetStringOption(v8::Local<v8::Value> options, const char *name,
+                     std::string *out);
+
+void SetMethod(v8::Local<v8::Object> instance, const char *name,
+               Nan::FunctionCallback method, AddonData *data);
+
+inline AddonData *AddonDataFrom(v8::Local<v8::Value> data) {
+  return static_cast<AddonData *>(data.As<v8::External>()->Value());
+}
+
+}  // namespace ts_native
+
+#endif  // TS_NATIVE_NATIVE_BINDING_H_
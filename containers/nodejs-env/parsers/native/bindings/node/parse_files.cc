@@ -0,0 +1,419 @@
+#include "native_binding.h"
+#include "batch_parse.h"
+#include "parse_cache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+
+using namespace v8;
+
+namespace ts_native {
+
+namespace {
+
+// State shared by all the workers spawned for one parseFiles() call.
+struct ParseFilesJob {
+  // `Sources` is a vector of paths or of SourceBuffers.
+  template <typename Sources>
+  ParseFilesJob(const Grammar *grammar, const ParseOptions &options,
+                Sources sources, Local<Function> callback, unsigned pending)
+      : batch(grammar, options, std::move(sources)),
+        callback(callback),
+        pending(pending) {}
+
+  ParseBatch batch;
+  Nan::Callback callback;
+  // Only touched on the main thread, from HandleOKCallback.
+  unsigned pending;
+};
+
+void SetField(Local<Object> object, const char *name, Local<Value> value) {
+  Nan::Set(object, Nan::New(name).ToLocalChecked(), value);
+}
+
+Local<Uint32Array> CopyToUint32Array(const void *data, size_t length) {
+  size_t size = length * sizeof(uint32_t);
+  Local<ArrayBuffer> buffer = ArrayBuffer::New(Isolate::GetCurrent(), size);
+  if (size > 0) memcpy(buffer->Data(), data, size);
+  return Uint32Array::New(buffer, 0, length);
+}
+
+// Comment lines as a flat Uint32Array of (row, startByte, endByte, indicator)
+// quadruples rather than one object per line.
+Local<Uint32Array> CommentLinesToArray(const std::vector<CommentLine> &lines) {
+  static_assert(sizeof(CommentLine) == 4 * sizeof(uint32_t),
+                "CommentLine is copied as four uint32 fields");
+  return CopyToUint32Array(lines.data(), lines.size() * 4);
+}
+
+// The copybooks a file pulled in and a flat Uint32Array source map of
+// (expandedStart, expandedLength, file, originalStart, originalLength)
+// quintuples, file being an index into `files`.
+Local<Object> ExpansionToObject(const ExpandedSource &expansion) {
+  Local<Object> object = Nan::New<Object>();
+
+  Local<Array> files = Nan::New<Array>(expansion.files.size());
+  for (uint32_t i = 0; i < expansion.files.size(); i++) {
+    Nan::Set(files, i, Nan::New(expansion.files[i]).ToLocalChecked());
+  }
+  SetField(object, "files", files);
+
+  static_assert(sizeof(SourceMapSegment) == 5 * sizeof(uint32_t),
+                "SourceMapSegment is copied as five uint32 fields");
+  SetField(object, "sourceMap",
+           CopyToUint32Array(expansion.segments.data(),
+                             expansion.segments.size() * 5));
+
+  Local<Array> errors = Nan::New<Array>(expansion.errors.size());
+  for (uint32_t i = 0; i < expansion.errors.size(); i++) {
+    const CopyError &error = expansion.errors[i];
+    Local<Object> entry = Nan::New<Object>();
+    SetField(entry, "file", Nan::New(error.file));
+    SetField(entry, "offset", Nan::New(error.offset));
+    SetField(entry, "message", Nan::New(error.message).ToLocalChecked());
+    Nan::Set(errors, i, entry);
+  }
+  SetField(object, "errors", errors);
+  return object;
+}
+
+// Tokens as (startByte, endByte, startRow, startColumn, endRow, endColumn)
+// sextuples and edges as (token, variable, relation, firstSource,
+// sourceCount) quintuples, firstSource indexing into `sources`.
+Local<Object> DataFlowToObject(const DataFlowGraph &graph) {
+  Local<Object> object = Nan::New<Object>();
+
+  static_assert(sizeof(DataFlowToken) == 6 * sizeof(uint32_t),
+                "DataFlowToken is copied as six uint32 fields");
+  static_assert(sizeof(DataFlowEdge) == 5 * sizeof(uint32_t),
+                "DataFlowEdge is copied as five uint32 fields");
+  SetField(object, "tokens",
+           CopyToUint32Array(graph.tokens.data(), graph.tokens.size() * 6));
+
+  Local<Array> variables = Nan::New<Array>(graph.variables.size());
+  for (uint32_t i = 0; i < graph.variables.size(); i++) {
+    Nan::Set(variables, i, Nan::New(graph.variables[i]).ToLocalChecked());
+  }
+  SetField(object, "variables", variables);
+
+  SetField(object, "edges",
+           CopyToUint32Array(graph.edges.data(), graph.edges.size() * 5));
+  SetField(object, "sources",
+           CopyToUint32Array(graph.sources.data(), graph.sources.size()));
+  return object;
+}
+
+// Blocks as (startByte, endByte, row, firstHostVariable, hostVariableCount)
+// quintuples, their SQL as strings and host variables as (block, startByte,
+// endByte, row, definitionStart, definitionEnd) sextuples.
+Local<Object> EmbeddedSqlToObject(const EmbeddedSql &embedded_sql) {
+  Local<Object> object = Nan::New<Object>();
+
+  static_assert(sizeof(SqlBlock) == 5 * sizeof(uint32_t),
+                "SqlBlock is copied as five uint32 fields");
+  static_assert(sizeof(HostVariable) == 6 * sizeof(uint32_t),
+                "HostVariable is copied as six uint32 fields");
+  SetField(object, "blocks",
+           CopyToUint32Array(embedded_sql.blocks.data(),
+                             embedded_sql.blocks.size() * 5));
+
+  Local<Array> sql = Nan::New<Array>(embedded_sql.sql.size());
+  for (uint32_t i = 0; i < embedded_sql.sql.size(); i++) {
+    Nan::Set(sql, i, Nan::New(embedded_sql.sql[i]).ToLocalChecked());
+  }
+  SetField(object, "sql", sql);
+
+  SetField(object, "hostVariables",
+           CopyToUint32Array(embedded_sql.host_variables.data(),
+                             embedded_sql.host_variables.size() * 6));
+  return object;
+}
+
+// Matches as (pattern, firstCapture, captureCount) triples and captures as
+// (capture, symbol, startByte, endByte, startRow, startColumn, endRow,
+// endColumn) octuples, firstCapture counting captures.
+Local<Object> QueryMatchesToObject(const QueryMatches &query_matches) {
+  Local<Object> object = Nan::New<Object>();
+
+  static_assert(sizeof(QueryMatch) == 3 * sizeof(uint32_t),
+                "QueryMatch is copied as three uint32 fields");
+  static_assert(sizeof(QueryCapture) == 8 * sizeof(uint32_t),
+                "QueryCapture is copied as eight uint32 fields");
+  SetField(object, "matches",
+           CopyToUint32Array(query_matches.matches.data(),
+                             query_matches.matches.size() * 3));
+  SetField(object, "captures",
+           CopyToUint32Array(query_matches.captures.data(),
+                             query_matches.captures.size() * 8));
+  return object;
+}
+
+Local<Object> ResultToObject(ParseResult &result, const ParseOptions &options) {
+  Local<Object> object = Nan::New<Object>();
+  if (!result.path.empty()) {
+    SetField(object, "path", Nan::New(result.path).ToLocalChecked());
+  }
+  if (!result.error.empty()) {
+    SetField(object, "error", Nan::New(result.error).ToLocalChecked());
+    return object;
+  }
+  SetField(object, "bytes", Nan::New(result.bytes));
+  if (options.expand_copybooks) {
+    SetField(object, "copybooks", ExpansionToObject(result.expansion));
+  }
+  if (!options.parse) {
+    SetField(object, "text", Nan::New(result.expansion.text).ToLocalChecked());
+    return object;
+  }
+  if (options.skeleton) {
+    // (kind, startByte, endByte, row, nameStart, nameEnd) sextuples.
+    static_assert(sizeof(Landmark) == 6 * sizeof(uint32_t),
+                  "Landmark is copied as six uint32 fields");
+    SetField(object, "skeleton",
+             CopyToUint32Array(result.skeleton.data(),
+                               result.skeleton.size() * 6));
+    SetField(object, "parseTime", Nan::New(result.parse_ms));
+    return object;
+  }
+  SetField(object, "nodeCount", Nan::New(result.node_count));
+  SetField(object, "errorCount", Nan::New(result.error_count));
+  SetField(object, "missingCount", Nan::New(result.missing_count));
+  SetField(object, "hasError",
+           Nan::New(result.error_count > 0 || result.missing_count > 0));
+  SetField(object, "parseTime", Nan::New(result.parse_ms));
+  if (options.cache) {
+    SetField(object, "cached", Nan::New(result.cached));
+  }
+  if (options.include_sexp) {
+    SetField(object, "sexp", Nan::New(result.sexp).ToLocalChecked());
+  }
+  if (options.include_flat) {
+    SetField(object, "flat", NewFlatTreeBuffer(&result.flat));
+  }
+  if (options.data_flow) {
+    SetField(object, "dataFlow", DataFlowToObject(result.data_flow));
+  }
+  if (options.query) {
+    SetField(object, "query", QueryMatchesToObject(result.query_matches));
+  }
+  if (options.embedded_sql) {
+    SetField(object, "embeddedSql", EmbeddedSqlToObject(result.embedded_sql));
+  }
+  if (options.fixed_format) {
+    SetField(object, "commentLines", CommentLinesToArray(result.comment_lines));
+  }
+  if (options.split_programs) {
+    // (startByte, endByte, startRow) triples.
+    static_assert(sizeof(ProgramSpan) == 3 * sizeof(uint32_t),
+                  "ProgramSpan is copied as three uint32 fields");
+    SetField(object, "programs",
+             CopyToUint32Array(result.programs.data(),
+                               result.programs.size() * 3));
+  }
+  return object;
+}
+
+class ParseFilesWorker : public Nan::AsyncWorker {
+ public:
+  explicit ParseFilesWorker(std::shared_ptr<ParseFilesJob> job)
+      : Nan::AsyncWorker(nullptr, "tree-sitter:parseFiles"),
+        job_(std::move(job)) {}
+
+  void Execute() override { job_->batch.run(); }
+
+  void HandleOKCallback() override {
+    if (--job_->pending > 0) return;
+
+    std::vector<ParseResult> &results = job_->batch.results();
+    Local<Array> array = Nan::New<Array>(results.size());
+    for (uint32_t i = 0; i < results.size(); i++) {
+      Nan::Set(array, i, ResultToObject(results[i], job_->batch.options()));
+    }
+
+    Local<Value> argv[] = {Nan::Null(), array};
+    job_->callback.Call(2, argv, async_resource);
+  }
+
+ private:
+  std::shared_ptr<ParseFilesJob> job_;
+};
+
+// Reads the options parseFiles and parseBuffers share. Throws and returns
+// false when they ask for something the grammar cannot do.
+bool ReadParseOptions(Local<Value> value, const Grammar *grammar,
+                      ParseOptions *options) {
+  options->timeout_micros = GetNumberOption(value, "timeoutMicros", 0);
+  options->include_sexp = GetBoolOption(value, "sexp", false);
+  options->include_flat = GetBoolOption(value, "flat", false);
+  options->fixed_format = GetBoolOption(value, "fixedFormat", false);
+  options->parse = GetBoolOption(value, "parse", true);
+  options->arena = GetBoolOption(value, "arena", false);
+  if (!GetEncodingOption(value, &options->code_page)) return false;
+  if (!GetQueryOption(value, grammar, &options->query)) return false;
+
+  Local<Object> copybooks;
+  if (GetObjectOption(value, "copybooks", &copybooks)) {
+    if (!grammar->copy_statements) {
+      Nan::ThrowTypeError("This grammar has no COPY statements to expand");
+      return false;
+    }
+    if (options->code_page) {
+      Nan::ThrowTypeError("Copybooks can only be expanded in UTF-8 sources");
+      return false;
+    }
+    options->expand_copybooks = true;
+    GetStringArray(Nan::Get(copybooks, Nan::New("directories").ToLocalChecked())
+                       .ToLocalChecked(),
+                   &options->copybooks.directories);
+    GetStringArray(Nan::Get(copybooks, Nan::New("extensions").ToLocalChecked())
+                       .ToLocalChecked(),
+                   &options->copybooks.extensions);
+    options->copybooks.fixed_format =
+        GetBoolOption(copybooks, "fixedFormat", true);
+  }
+
+  options->data_flow = GetBoolOption(value, "dataFlow", false);
+  if (options->data_flow && !grammar->data_flow) {
+    Nan::ThrowTypeError("This grammar has no data flow rules");
+    return false;
+  }
+
+  options->embedded_sql = GetBoolOption(value, "embeddedSql", false);
+  if (options->embedded_sql && !grammar->embedded_sql) {
+    Nan::ThrowTypeError("This grammar has no EXEC SQL blocks");
+    return false;
+  }
+
+  options->skeleton = GetBoolOption(value, "skeleton", false);
+  if (options->skeleton && !grammar->extract_skeleton) {
+    Nan::ThrowTypeError("This grammar has no skeleton extractor");
+    return false;
+  }
+
+  options->split_programs = GetBoolOption(value, "splitPrograms", false);
+  if (options->split_programs && !grammar->split_programs) {
+    Nan::ThrowTypeError("This grammar cannot split programs");
+    return false;
+  }
+
+  std::string cache_directory;
+  if (GetStringOption(value, "cache", &cache_directory)) {
+    std::string error;
+    options->cache = ParseCache::Get(cache_directory, grammar->language, &error);
+    if (!options->cache) {
+      Nan::ThrowError(error.c_str());
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename Sources>
+void QueueParseJob(const Grammar *grammar, const ParseOptions &options,
+                   Sources sources, Local<Value> option_values,
+                   Local<Function> callback) {
+  double workers = GetNumberOption(option_values, "concurrency", 1);
+  if (!(workers >= 1) || std::isinf(workers)) {
+    Nan::ThrowRangeError("concurrency must be a positive number of workers");
+    return;
+  }
+  // libuv never runs more pool threads than this, so further workers would
+  // only queue up behind the others.
+  size_t concurrency = static_cast<size_t>(std::min(workers, 1024.0));
+  // Split programs keep more workers busy than there are sources.
+  if (!options.split_programs) {
+    concurrency = std::min(concurrency, sources.size());
+  }
+  concurrency = std::max<size_t>(1, concurrency);
+
+  auto job = std::make_shared<ParseFilesJob>(
+      grammar, options, std::move(sources), callback, concurrency);
+  for (size_t i = 0; i < concurrency; i++) {
+    Nan::AsyncQueueWorker(new ParseFilesWorker(job));
+  }
+}
+
+NAN_METHOD(ParseFiles) {
+  std::vector<std::string> paths;
+  if (!GetStringArray(info[0], &paths)) {
+    Nan::ThrowTypeError("First argument must be an array of paths");
+    return;
+  }
+  if (!info[2]->IsFunction()) {
+    Nan::ThrowTypeError("Third argument must be a callback");
+    return;
+  }
+
+  const Grammar *grammar = AddonDataFrom(info.Data())->grammar();
+  ParseOptions options;
+  if (!ReadParseOptions(info[1], grammar, &options)) return;
+  QueueParseJob(grammar, options, std::move(paths), info[1],
+                info[2].As<Function>());
+}
+
+// The buffers are parsed where they are: each SourceBuffer holds a reference
+// to its V8 backing store, which keeps the bytes alive on the pool threads
+// even if JS drops or transfers the buffer meanwhile.
+bool GetSourceBuffers(Local<Value> value, std::vector<SourceBuffer> *out) {
+  if (!value->IsArray()) return false;
+  Local<Array> array = value.As<Array>();
+  out->reserve(array->Length());
+  for (uint32_t i = 0; i < array->Length(); i++) {
+    Local<Value> element = Nan::Get(array, i).ToLocalChecked();
+    std::shared_ptr<BackingStore> store;
+    size_t offset = 0;
+    size_t length;
+    if (element->IsArrayBufferView()) {
+      Local<ArrayBufferView> view = element.As<ArrayBufferView>();
+      store = view->Buffer()->GetBackingStore();
+      offset = view->ByteOffset();
+      length = view->ByteLength();
+    } else if (element->IsArrayBuffer()) {
+      store = element.As<ArrayBuffer>()->GetBackingStore();
+      length = store->ByteLength();
+    } else {
+      return false;
+    }
+    const char *data = static_cast<const char *>(store->Data()) + offset;
+    out->push_back({std::move(store), data, length});
+  }
+  return true;
+}
+
+NAN_METHOD(ParseBuffers) {
+  std::vector<SourceBuffer> buffers;
+  if (!GetSourceBuffers(info[0], &buffers)) {
+    Nan::ThrowTypeError(
+        "First argument must be an array of Buffers or ArrayBuffers");
+    return;
+  }
+  if (!info[2]->IsFunction()) {
+    Nan::ThrowTypeError("Third argument must be a callback");
+    return;
+  }
+
+  const Grammar *grammar = AddonDataFrom(info.Data())->grammar();
+  ParseOptions options;
+  if (!ReadParseOptions(info[1], grammar, &options)) return;
+  if (options.expand_copybooks) {
+    Nan::ThrowTypeError("Copybooks are only expanded by parseFiles");
+    return;
+  }
+  if (!options.parse) {
+    Nan::ThrowTypeError("parse: false is not supported for buffers");
+    return;
+  }
+  QueueParseJob(grammar, options, std::move(buffers), info[1],
+                info[2].As<Function>());
+}
+
+}  // namespace
+
+void InitParseFiles(Local<Object> instance, AddonData *data) {
+  SetMethod(instance, "_parseFiles", ParseFiles, data);
+  SetMethod(instance, "_parseBuffers", ParseBuffers, data);
+}
+
+}  // namespace ts_native
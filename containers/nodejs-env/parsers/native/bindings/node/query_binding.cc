@@ -0,0 +1,59 @@
+#include "native_binding.h"
+#include "query.h"
+
+using namespace v8;
+
+namespace ts_native {
+
+namespace {
+
+const Query *CompileQuery(const Grammar *grammar, const std::string &source) {
+  std::string error;
+  const Query *query = Query::Get(grammar->language, source, &error);
+  if (!query) Nan::ThrowSyntaxError(error.c_str());
+  return query;
+}
+
+// compileQuery(source): compiles the query for this language, or throws a
+// SyntaxError, and returns { source, captureNames, patternCount }. The
+// compiled query stays cached, so passing `source` as the `query` option of
+// parseFiles later costs a map lookup.
+NAN_METHOD(CompileQueryMethod) {
+  if (!info[0]->IsString()) {
+    Nan::ThrowTypeError("First argument must be a query string");
+    return;
+  }
+  std::string source = *Nan::Utf8String(info[0]);
+  const Query *query =
+      CompileQuery(AddonDataFrom(info.Data())->grammar(), source);
+  if (!query) return;
+
+  std::vector<std::string> names = query->capture_names();
+  Local<Array> capture_names = Nan::New<Array>(names.size());
+  for (uint32_t i = 0; i < names.size(); i++) {
+    Nan::Set(capture_names, i, Nan::New(names[i]).ToLocalChecked());
+  }
+  Local<Object> result = Nan::New<Object>();
+  Nan::Set(result, Nan::New("source").ToLocalChecked(), info[0]);
+  Nan::Set(result, Nan::New("captureNames").ToLocalChecked(), capture_names);
+  Nan::Set(result, Nan::New("patternCount").ToLocalChecked(),
+           Nan::New(query->pattern_count()));
+  info.GetReturnValue().Set(result);
+}
+
+}  // namespace
+
+bool GetQueryOption(Local<Value> options, const Grammar *grammar,
+                    const Query **out) {
+  std::string source;
+  *out = nullptr;
+  if (!GetStringOption(options, "query", &source)) return true;
+  *out = CompileQuery(grammar, source);
+  return *out != nullptr;
+}
+
+void InitQuery(Local<Object> instance, AddonData *data) {
+  SetMethod(instance, "_compileQuery", CompileQueryMethod, data);
+}
+
+}  // namespace ts_native
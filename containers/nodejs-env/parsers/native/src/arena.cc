@@ -0,0 +1,177 @@
+#include "arena.h"
+
+#include <tree_sitter/api.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+namespace ts_native {
+
+namespace {
+
+// Every allocation is preceded by its size, which keeps the 16-byte
+// alignment malloc guarantees.
+const size_t kHeader = 16;
+const size_t kAlignment = 16;
+const size_t kMinBlock = 256 << 10;
+// A thread keeps at most this much between parses.
+const size_t kMaxRetained = 64 << 20;
+
+size_t align(size_t size) {
+  return (size + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+size_t &size_of(void *pointer) {
+  return *reinterpret_cast<size_t *>(static_cast<char *>(pointer) - kHeader);
+}
+
+char *new_block(size_t size) {
+  char *data = static_cast<char *>(malloc(size));
+  if (!data) {
+    fprintf(stderr, "tree-sitter arena failed to allocate %zu bytes\n", size);
+    abort();
+  }
+  return data;
+}
+
+thread_local Arena *current_arena = nullptr;
+
+Arena &thread_arena() {
+  thread_local Arena arena;
+  return arena;
+}
+
+void *arena_malloc(size_t size) {
+  Arena *arena = current_arena;
+  return arena ? arena->allocate(size) : malloc(size);
+}
+
+void *arena_calloc(size_t count, size_t size) {
+  Arena *arena = current_arena;
+  if (!arena) return calloc(count, size);
+  if (size != 0 && count > SIZE_MAX / size) return nullptr;
+  void *pointer = arena->allocate(count * size);
+  memset(pointer, 0, count * size);
+  return pointer;
+}
+
+void *arena_realloc(void *pointer, size_t size) {
+  Arena *arena = current_arena;
+  if (arena && (!pointer || arena->owns(pointer))) {
+    return arena->reallocate(pointer, size);
+  }
+  return realloc(pointer, size);
+}
+
+void arena_free(void *pointer) {
+  Arena *arena = current_arena;
+  if (arena && arena->owns(pointer)) {
+    arena->release(pointer);
+  } else {
+    free(pointer);
+  }
+}
+
+}  // namespace
+
+Arena::~Arena() {
+  for (Block &block : blocks_) free(block.data);
+}
+
+void *Arena::allocate(size_t size) {
+  size_t total = kHeader + align(size);
+  if (blocks_.empty() || blocks_.back().size - blocks_.back().used < total) {
+    return allocate_in_new_block(size);
+  }
+  Block &block = blocks_.back();
+  char *pointer = block.data + block.used + kHeader;
+  block.used += total;
+  size_of(pointer) = size;
+  last_ = pointer;
+  return pointer;
+}
+
+void *Arena::allocate_in_new_block(size_t size) {
+  size_t total = kHeader + align(size);
+  size_t block_size = blocks_.empty() ? kMinBlock : blocks_.back().size * 2;
+  block_size = std::max(block_size, total);
+  blocks_.push_back({new_block(block_size), block_size, 0});
+  return allocate(size);
+}
+
+void *Arena::reallocate(void *pointer, size_t size) {
+  if (!pointer) return allocate(size);
+  size_t old_size = size_of(pointer);
+  if (pointer == last_) {
+    // The last allocation grows or shrinks in place while its block has room.
+    Block &block = blocks_.back();
+    size_t start = static_cast<char *>(pointer) - block.data;
+    if (start + align(size) <= block.size) {
+      block.used = start + align(size);
+      size_of(pointer) = size;
+      return pointer;
+    }
+  } else if (size <= old_size) {
+    return pointer;
+  }
+  void *moved = allocate(size);
+  memcpy(moved, pointer, std::min(old_size, size));
+  return moved;
+}
+
+void Arena::release(void *pointer) {
+  if (pointer != last_) return;
+  Block &block = blocks_.back();
+  block.used = static_cast<char *>(pointer) - kHeader - block.data;
+  last_ = nullptr;
+}
+
+bool Arena::owns(const void *pointer) const {
+  const char *p = static_cast<const char *>(pointer);
+  // The newest block, which holds most live allocations, is checked first.
+  for (size_t i = blocks_.size(); i-- > 0;) {
+    const Block &block = blocks_[i];
+    if (p >= block.data && p < block.data + block.size) return true;
+  }
+  return false;
+}
+
+void Arena::reset() {
+  last_ = nullptr;
+  if (blocks_.size() == 1 && blocks_[0].size <= kMaxRetained) {
+    blocks_[0].used = 0;
+    return;
+  }
+  // Replaced by one block as large as all of them, so the next parse of a
+  // file this size fits in it.
+  size_t total = 0;
+  for (Block &block : blocks_) {
+    total += block.size;
+    free(block.data);
+  }
+  blocks_.clear();
+  total = std::min(total, kMaxRetained);
+  if (total > 0) blocks_.push_back({new_block(total), total, 0});
+}
+
+void runtime_free(void *pointer) { arena_free(pointer); }
+
+ArenaScope::ArenaScope() {
+  static std::once_flag installed;
+  std::call_once(installed, [] {
+    ts_set_allocator(arena_malloc, arena_calloc, arena_realloc, arena_free);
+  });
+  current_arena = &thread_arena();
+}
+
+ArenaScope::~ArenaScope() {
+  Arena *arena = current_arena;
+  current_arena = nullptr;
+  arena->reset();
+}
+
+}  // namespace ts_native
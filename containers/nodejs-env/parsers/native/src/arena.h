@@ -0,0 +1,67 @@
+#ifndef TS_NATIVE_ARENA_H_
+#define TS_NATIVE_ARENA_H_
+
+#include <cstddef>
+#include <vector>
+
+namespace ts_native {
+
+// A bump allocator for everything the tree-sitter runtime allocates during
+// one parse: the parser, its stacks and lexer, the external scanner's state
+// and every subtree of the tree. free() of the last allocation rolls it
+// back, any other free() is a no-op, and reset() releases the lot at once.
+// Blocks are kept across resets, so a thread that parses many files settles
+// on one block and stops calling malloc altogether.
+class Arena {
+ public:
+  Arena() = default;
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+  ~Arena();
+
+  void *allocate(size_t size);
+  void *reallocate(void *pointer, size_t size);
+  void release(void *pointer);
+  bool owns(const void *pointer) const;
+  void reset();
+
+ private:
+  struct Block {
+    char *data;
+    size_t size;
+    size_t used;
+  };
+
+  void *allocate_in_new_block(size_t size);
+
+  std::vector<Block> blocks_;
+  // The allocation release() and reallocate() can resize in place.
+  char *last_ = nullptr;
+};
+
+// While an ArenaScope is open, every runtime allocation made on its thread
+// comes from that thread's Arena; the scope's end frees them all. Nothing
+// allocated inside may outlive it, so the parser, tree and cursors have to
+// be created and deleted within it (see parse_source). Other threads, and
+// this one outside a scope, keep using malloc.
+//
+// The first scope installs the arena-aware functions with ts_set_allocator.
+// They fall back to malloc for memory they did not hand out, so the switch
+// is safe while other threads are parsing. External scanners built with
+// TREE_SITTER_REUSE_ALLOCATOR take their state from the arena too.
+class ArenaScope {
+ public:
+  ArenaScope();
+  ArenaScope(const ArenaScope &) = delete;
+  ArenaScope &operator=(const ArenaScope &) = delete;
+  ~ArenaScope();
+};
+
+// Frees memory the runtime handed out to the caller, such as the string
+// ts_node_string returns, inside an ArenaScope or not. Plain free() aborts
+// on memory that came from an arena.
+void runtime_free(void *pointer);
+
+}  // namespace ts_native
+
+#endif  // TS_NATIVE_ARENA_H_
@@ -0,0 +1,516 @@
+#include "batch_parse.h"
+
+#include "arena.h"
+#include "parse_cache.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+
+namespace ts_native {
+
+namespace {
+
+struct ParserDeleter {
+  void operator()(TSParser *parser) const { ts_parser_delete(parser); }
+};
+
+struct TreeDeleter {
+  void operator()(TSTree *tree) const { ts_tree_delete(tree); }
+};
+
+void count_nodes(TSNode root, ParseResult *result) {
+  TSTreeCursor cursor = ts_tree_cursor_new(root);
+  for (;;) {
+    TSNode node = ts_tree_cursor_current_node(&cursor);
+    result->node_count++;
+    if (ts_node_is_error(node)) result->error_count++;
+    if (ts_node_is_missing(node)) result->missing_count++;
+
+    if (ts_tree_cursor_goto_first_child(&cursor)) continue;
+    while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+      if (!ts_tree_cursor_goto_parent(&cursor)) {
+        ts_tree_cursor_delete(&cursor);
+        return;
+      }
+    }
+  }
+}
+
+void count_nodes(const FlatTree &flat, ParseResult *result) {
+  const uint16_t *symbol = flat.symbols();
+  const uint8_t *flags = flat.flags();
+
+  result->node_count = flat.node_count();
+  for (uint32_t i = 0; i < flat.node_count(); i++) {
+    if (symbol[i] == static_cast<TSSymbol>(-1)) result->error_count++;
+    if (flags[i] & flat_tree::kFlagMissing) result->missing_count++;
+  }
+}
+
+// Shifts the results of a program parsed on its own to where it starts in
+// the document.
+void shift_program(const ProgramSpan &span, ParseResult *part) {
+  for (CommentLine &line : part->comment_lines) {
+    line.row += span.start_row;
+    line.start_byte += span.start_byte;
+    line.end_byte += span.start_byte;
+  }
+  for (DataFlowToken &token : part->data_flow.tokens) {
+    token.start_byte += span.start_byte;
+    token.end_byte += span.start_byte;
+    token.start_row += span.start_row;
+    token.end_row += span.start_row;
+  }
+  for (QueryCapture &capture : part->query_matches.captures) {
+    capture.start_byte += span.start_byte;
+    capture.end_byte += span.start_byte;
+    capture.start_row += span.start_row;
+    capture.end_row += span.start_row;
+  }
+  for (SqlBlock &block : part->embedded_sql.blocks) {
+    block.start_byte += span.start_byte;
+    block.end_byte += span.start_byte;
+    block.row += span.start_row;
+  }
+  for (HostVariable &variable : part->embedded_sql.host_variables) {
+    variable.start_byte += span.start_byte;
+    variable.end_byte += span.start_byte;
+    variable.row += span.start_row;
+    if (variable.definition_start != kNoDefinition) {
+      variable.definition_start += span.start_byte;
+      variable.definition_end += span.start_byte;
+    }
+  }
+}
+
+// Appends the embedded SQL of a later program. Host variables only resolve
+// to data names of their own program.
+void append_embedded_sql(EmbeddedSql *part, EmbeddedSql *sql) {
+  uint32_t block_base = static_cast<uint32_t>(sql->blocks.size());
+  uint32_t variable_base = static_cast<uint32_t>(sql->host_variables.size());
+  for (SqlBlock block : part->blocks) {
+    block.first_host_variable += variable_base;
+    sql->blocks.push_back(block);
+  }
+  for (HostVariable variable : part->host_variables) {
+    variable.block += block_base;
+    sql->host_variables.push_back(variable);
+  }
+  for (std::string &text : part->sql) sql->sql.push_back(std::move(text));
+}
+
+// Appends the data flow of a later program. Its variables are renumbered
+// into the document's; definitions never flow from one program to the next.
+void append_data_flow(DataFlowGraph *part,
+                      std::unordered_map<std::string, uint32_t> *ids,
+                      DataFlowGraph *graph) {
+  uint32_t token_base = static_cast<uint32_t>(graph->tokens.size());
+  uint32_t source_base = static_cast<uint32_t>(graph->sources.size());
+  std::vector<uint32_t> variables(part->variables.size());
+  for (size_t i = 0; i < part->variables.size(); i++) {
+    auto inserted = ids->emplace(
+        part->variables[i], static_cast<uint32_t>(graph->variables.size()));
+    if (inserted.second) graph->variables.push_back(part->variables[i]);
+    variables[i] = inserted.first->second;
+  }
+  graph->tokens.insert(graph->tokens.end(), part->tokens.begin(),
+                       part->tokens.end());
+  for (DataFlowEdge edge : part->edges) {
+    edge.token += token_base;
+    edge.variable = variables[edge.variable];
+    edge.first_source += source_base;
+    graph->edges.push_back(edge);
+  }
+  for (uint32_t source : part->sources) {
+    graph->sources.push_back(source + token_base);
+  }
+}
+
+// Joins the results of the programs of one document into `result`, as if the
+// document had been parsed whole: one root over the top-level nodes of every
+// program. The first error stops the join.
+void join_programs(const std::vector<ProgramSpan> &programs,
+                   std::vector<ParseResult> *parts, ParseResult *result) {
+  for (size_t p = 0; p < parts->size(); p++) {
+    if (!(*parts)[p].error.empty()) {
+      result->error =
+          "program " + std::to_string(p + 1) + ": " + (*parts)[p].error;
+      return;
+    }
+  }
+
+  std::vector<FlatTree> flats;
+  std::vector<uint32_t> byte_offsets, row_offsets;
+  std::unordered_map<std::string, uint32_t> variable_ids;
+  result->node_count = 1;
+  result->cached = true;
+  for (size_t p = 0; p < parts->size(); p++) {
+    ParseResult &part = (*parts)[p];
+    const ProgramSpan &span = programs[p];
+    shift_program(span, &part);
+    result->node_count += part.node_count - 1;
+    result->error_count += part.error_count;
+    result->missing_count += part.missing_count;
+    result->parse_ms += part.parse_ms;
+    result->cached = result->cached && part.cached;
+    result->comment_lines.insert(result->comment_lines.end(),
+                                 part.comment_lines.begin(),
+                                 part.comment_lines.end());
+    append_data_flow(&part.data_flow, &variable_ids, &result->data_flow);
+    append_embedded_sql(&part.embedded_sql, &result->embedded_sql);
+
+    QueryMatches &matches = result->query_matches;
+    uint32_t capture_base = static_cast<uint32_t>(matches.captures.size());
+    for (QueryMatch match : part.query_matches.matches) {
+      match.first_capture += capture_base;
+      matches.matches.push_back(match);
+    }
+    matches.captures.insert(matches.captures.end(),
+                            part.query_matches.captures.begin(),
+                            part.query_matches.captures.end());
+
+    // "(start (a) (b))" and "(start (c))" become "(start (a) (b) (c))".
+    if (!part.sexp.empty()) {
+      if (p == 0) {
+        result->sexp = part.sexp.substr(0, part.sexp.size() - 1);
+      } else {
+        size_t space = part.sexp.find(' ');
+        if (space != std::string::npos) {
+          result->sexp.append(part.sexp, space, part.sexp.size() - space - 1);
+        }
+      }
+      if (p + 1 == parts->size()) result->sexp += ')';
+    }
+
+    if (part.flat.node_count() > 0) {
+      flats.push_back(std::move(part.flat));
+      byte_offsets.push_back(span.start_byte);
+      row_offsets.push_back(span.start_row);
+    }
+  }
+  if (flats.size() == parts->size()) {
+    result->flat = FlatTree::Join(flats, byte_offsets, row_offsets);
+    if (!result->flat.data()) {
+      result->error = "out of memory flattening the tree";
+    }
+  }
+}
+
+}  // namespace
+
+TSParser *thread_parser(const TSLanguage *language) {
+  thread_local std::unique_ptr<TSParser, ParserDeleter> parser(ts_parser_new());
+  if (ts_parser_language(parser.get()) != language) {
+    ts_parser_set_language(parser.get(), language);
+  }
+  return parser.get();
+}
+
+bool read_file(const std::string &path, std::string *contents,
+               std::string *error) {
+  FILE *file = fopen(path.c_str(), "rb");
+  if (!file) {
+    *error = "cannot open " + path + ": " + strerror(errno);
+    return false;
+  }
+
+  contents->clear();
+  char chunk[1 << 16];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+    contents->append(chunk, n);
+  }
+  bool ok = !ferror(file);
+  if (!ok) *error = "cannot read " + path;
+  fclose(file);
+  return ok;
+}
+
+bool load_file(const Grammar &grammar, const ParseOptions &options,
+               ParseResult *result, std::string *source) {
+  if (!read_file(result->path, source, &result->error)) return false;
+  if (options.expand_copybooks && grammar.copy_statements) {
+    expand_copybooks(result->path, *source, options.copybooks,
+                     &result->expansion);
+    source->swap(result->expansion.text);
+  }
+  return true;
+}
+
+void parse_file(const Grammar &grammar, const ParseOptions &options,
+                ParseResult *result) {
+  std::string source;
+  if (!load_file(grammar, options, result, &source)) return;
+  if (!options.parse) {
+    result->bytes = static_cast<uint32_t>(source.size());
+    result->expansion.text.swap(source);
+    return;
+  }
+  parse_source(grammar, options, source.data(),
+               static_cast<uint32_t>(source.size()), result);
+}
+
+void parse_source(const Grammar &grammar, const ParseOptions &options,
+                  const char *source, uint32_t length, ParseResult *result) {
+  result->bytes = length;
+  if (options.skeleton && grammar.extract_skeleton) {
+    auto start = std::chrono::steady_clock::now();
+    grammar.extract_skeleton(source, length, options.code_page,
+                             &result->skeleton);
+    auto end = std::chrono::steady_clock::now();
+    result->parse_ms =
+        std::chrono::duration<double, std::milli>(end - start).count();
+    return;
+  }
+
+  const ParseCache *cache =
+      options.cache && ParseCache::Covers(options) ? options.cache : nullptr;
+  if (cache) {
+    auto start = std::chrono::steady_clock::now();
+    if (cache->Load(source, length, options, result)) {
+      auto end = std::chrono::steady_clock::now();
+      result->parse_ms =
+          std::chrono::duration<double, std::milli>(end - start).count();
+      result->cached = true;
+      return;
+    }
+  }
+
+  // In arena mode the parser is made for this parse alone, inside the arena,
+  // and goes with it: memory the thread's own parser keeps between parses
+  // cannot come from an arena that is reset when the parse is done.
+  std::unique_ptr<ArenaScope> arena;
+  std::unique_ptr<TSParser, ParserDeleter> arena_parser;
+  TSParser *parser;
+  if (options.arena) {
+    arena.reset(new ArenaScope());
+    arena_parser.reset(ts_parser_new());
+    ts_parser_set_language(arena_parser.get(), grammar.language);
+    parser = arena_parser.get();
+  } else {
+    parser = thread_parser(grammar.language);
+  }
+  ts_parser_set_timeout_micros(parser, options.timeout_micros);
+
+  // Code-page sources are decoded to UTF-16 as the parser reads them, which
+  // doubles every offset in the tree.
+  const CodePage *code_page = options.code_page;
+  uint32_t byte_shift = code_page ? CodePageInput::kByteShift : 0;
+
+  bool fixed_format =
+      options.fixed_format && grammar.set_source_areas_stripped;
+  auto start = std::chrono::steady_clock::now();
+  if (fixed_format) {
+    SourceAreas areas;
+    scan_fixed_format(source, length, &areas, code_page);
+    for (TSRange &range : areas.ranges) {
+      range.start_byte <<= byte_shift;
+      range.end_byte <<= byte_shift;
+      range.start_point.column <<= byte_shift;
+      range.end_point.column <<= byte_shift;
+    }
+    ts_parser_set_included_ranges(parser, areas.ranges.data(),
+                                  areas.ranges.size());
+    grammar.set_source_areas_stripped(true);
+    result->comment_lines = std::move(areas.comments);
+  }
+  std::unique_ptr<TSTree, TreeDeleter> tree;
+  if (code_page) {
+    CodePageInput input(*code_page, source, length);
+    tree.reset(ts_parser_parse(parser, nullptr, input.input()));
+  } else {
+    tree.reset(ts_parser_parse_string(parser, nullptr, source, length));
+  }
+  if (fixed_format) {
+    // The parser is reused by the next file on this thread.
+    grammar.set_source_areas_stripped(false);
+    ts_parser_set_included_ranges(parser, nullptr, 0);
+  }
+  auto end = std::chrono::steady_clock::now();
+  result->parse_ms =
+      std::chrono::duration<double, std::milli>(end - start).count();
+
+  if (!tree) {
+    // A timed out parse leaves state behind that would be resumed by the
+    // next call on this thread.
+    ts_parser_reset(parser);
+    result->error = "parse timed out";
+    return;
+  }
+
+  TSNode root = ts_tree_root_node(tree.get());
+  if (options.include_flat || cache) {
+    // The flat columns already hold everything the counters need, so avoid
+    // walking the tree a second time.
+    result->flat = FlatTree::FromNode(root, byte_shift);
+    if (!result->flat.data()) {
+      result->error = "out of memory flattening the tree";
+      return;
+    }
+    count_nodes(result->flat, result);
+    if (cache) {
+      cache->Store(source, length, options, *result);
+      if (!options.include_flat) result->flat = FlatTree();
+    }
+  } else {
+    count_nodes(root, result);
+  }
+
+  if (options.data_flow && grammar.data_flow) {
+    extract_data_flow(grammar.language, *grammar.data_flow, root, source,
+                      code_page, &result->data_flow);
+  }
+
+  if (options.query) {
+    run_query(*options.query, root, source, code_page, &result->query_matches);
+  }
+
+  if (options.embedded_sql && grammar.embedded_sql) {
+    extract_embedded_sql(grammar.language, root, source, code_page,
+                         &result->embedded_sql);
+  }
+
+  if (options.include_sexp) {
+    char *sexp = ts_node_string(root);
+    result->sexp = sexp;
+    runtime_free(sexp);
+  }
+}
+
+ParseBatch::ParseBatch(const Grammar *grammar, const ParseOptions &options,
+                       std::vector<std::string> paths)
+    : grammar_(grammar), options_(options), results_(paths.size()), next_(0) {
+  for (size_t i = 0; i < paths.size(); i++) {
+    results_[i].path = std::move(paths[i]);
+  }
+}
+
+ParseBatch::ParseBatch(const Grammar *grammar, const ParseOptions &options,
+                       std::vector<SourceBuffer> buffers)
+    : grammar_(grammar),
+      options_(options),
+      buffers_(std::move(buffers)),
+      results_(buffers_.size()),
+      next_(0) {}
+
+struct ParseBatch::SplitDocument {
+  size_t index;
+  // The file's text; buffers are parsed in place.
+  std::string text;
+  const char *data;
+  std::vector<ProgramSpan> programs;
+  std::vector<ParseResult> parts;
+  std::atomic<size_t> remaining;
+};
+
+void ParseBatch::run() {
+  if (options_.split_programs && grammar_->split_programs &&
+      options_.parse && !options_.skeleton) {
+    run_split();
+    return;
+  }
+  for (size_t i = next_++; i < results_.size(); i = next_++) {
+    if (buffers_.empty()) {
+      parse_file(*grammar_, options_, &results_[i]);
+      continue;
+    }
+    const SourceBuffer &buffer = buffers_[i];
+    if (buffer.length > UINT32_MAX) {
+      results_[i].error = "buffer larger than 4 GiB";
+      continue;
+    }
+    parse_source(*grammar_, options_, buffer.data,
+                 static_cast<uint32_t>(buffer.length), &results_[i]);
+  }
+}
+
+void ParseBatch::run_split() {
+  for (;;) {
+    ProgramTask task;
+    size_t index = 0;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      for (;;) {
+        if (!tasks_.empty()) {
+          task = std::move(tasks_.front());
+          tasks_.pop_front();
+          break;
+        }
+        index = next_++;
+        if (index < results_.size()) {
+          splitting_++;
+          break;
+        }
+        // Whoever is still splitting a document may queue more programs.
+        if (splitting_ == 0) return;
+        queued_.wait(lock);
+      }
+    }
+    if (task.document) {
+      parse_program(task);
+      continue;
+    }
+    split(index);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      splitting_--;
+    }
+    queued_.notify_all();
+  }
+}
+
+void ParseBatch::split(size_t index) {
+  ParseResult *result = &results_[index];
+  auto document = std::make_shared<SplitDocument>();
+  document->index = index;
+  uint32_t length;
+  if (buffers_.empty()) {
+    if (!load_file(*grammar_, options_, result, &document->text)) return;
+    document->data = document->text.data();
+    length = static_cast<uint32_t>(document->text.size());
+  } else {
+    const SourceBuffer &buffer = buffers_[index];
+    if (buffer.length > UINT32_MAX) {
+      result->error = "buffer larger than 4 GiB";
+      return;
+    }
+    document->data = buffer.data;
+    length = static_cast<uint32_t>(buffer.length);
+  }
+
+  find_programs(document->data, length, options_.code_page,
+                options_.fixed_format && grammar_->set_source_areas_stripped,
+                &document->programs);
+  if (document->programs.size() <= 1) {
+    parse_source(*grammar_, options_, document->data, length, result);
+    result->programs = std::move(document->programs);
+    return;
+  }
+
+  result->bytes = length;
+  result->programs = document->programs;
+  document->parts.resize(document->programs.size());
+  document->remaining = document->programs.size();
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (size_t i = 0; i < document->programs.size(); i++) {
+    tasks_.push_back({document, i});
+  }
+}
+
+void ParseBatch::parse_program(const ProgramTask &task) {
+  SplitDocument &document = *task.document;
+  const ProgramSpan &span = document.programs[task.program];
+  parse_source(*grammar_, options_, document.data + span.start_byte,
+               span.end_byte - span.start_byte, &document.parts[task.program]);
+  if (--document.remaining == 0) {
+    join_programs(document.programs, &document.parts,
+                  &results_[document.index]);
+  }
+}
+
+}  // namespace ts_native
@@ -0,0 +1,179 @@
+#ifndef TS_NATIVE_BATCH_PARSE_H_
+#define TS_NATIVE_BATCH_PARSE_H_
+
+#include <tree_sitter/api.h>
+
+#include "code_page.h"
+#include "copybook.h"
+#include "data_flow.h"
+#include "embedded_sql.h"
+#include "flat_tree.h"
+#include "grammar.h"
+#include "program_split.h"
+#include "query.h"
+#include "skeleton.h"
+#include "source_areas.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ts_native {
+
+class ParseCache;
+
+struct ParseOptions {
+  uint64_t timeout_micros = 0;
+  bool include_sexp = false;
+  bool include_flat = false;
+  // Parse only the source area of fixed-format programs, see source_areas.h.
+  bool fixed_format = false;
+  // Expand COPY statements first, for grammars with Grammar::copy_statements.
+  // Byte offsets in the results then refer to the expanded text.
+  bool expand_copybooks = false;
+  CopybookOptions copybooks;
+  // False to stop after reading and expanding, keeping the expanded text.
+  bool parse = true;
+  // Extract tokens and data flow edges, for grammars with Grammar::data_flow.
+  bool data_flow = false;
+  // Encoding of the sources, null for UTF-8. Offsets in the results are
+  // always in the bytes of the source as given.
+  const CodePage *code_page = nullptr;
+  // Allocate the parser, scanner and tree of every parse from a per-thread
+  // arena released in one go when the parse is done, see arena.h.
+  bool arena = false;
+  // Run this query over each tree, see query.h.
+  const Query *query = nullptr;
+  // Parse each program of a multi-program document as a task of its own,
+  // for grammars with Grammar::split_programs, and join the results.
+  bool split_programs = false;
+  // List the landmarks of each document instead of parsing it, for grammars
+  // with Grammar::extract_skeleton.
+  bool skeleton = false;
+  // Read the SQL and host variables of EXEC SQL blocks, for grammars with
+  // Grammar::embedded_sql.
+  bool embedded_sql = false;
+  // Serve unchanged sources from this cache and store the others in it,
+  // when ParseCache::Covers the options, see parse_cache.h.
+  const ParseCache *cache = nullptr;
+};
+
+// Bytes parsed in place rather than read from a file. `owner` keeps them
+// alive while pool threads parse them, e.g. the V8 backing store of a Buffer.
+struct SourceBuffer {
+  std::shared_ptr<void> owner;
+  const char *data;
+  size_t length;
+};
+
+struct ParseResult {
+  // Empty for a SourceBuffer.
+  std::string path;
+  // Set when the file could not be read, the parse was cancelled or its
+  // results could not be allocated.
+  std::string error;
+  // S-expression of the tree, only filled in when ParseOptions::include_sexp.
+  std::string sexp;
+  // Flattened tree, only filled in when ParseOptions::include_flat.
+  FlatTree flat;
+  // Comment lines kept out of the tree, only filled in for fixed_format.
+  std::vector<CommentLine> comment_lines;
+  // Files and source map of the expansion, only filled in with
+  // expand_copybooks. Its text is kept only when the file is not parsed.
+  ExpandedSource expansion;
+  // Only filled in when ParseOptions::data_flow.
+  DataFlowGraph data_flow;
+  // Matches of ParseOptions::query that satisfy its predicates.
+  QueryMatches query_matches;
+  // Only filled in when ParseOptions::embedded_sql.
+  EmbeddedSql embedded_sql;
+  // The programs the document was split into, only filled in with
+  // split_programs.
+  std::vector<ProgramSpan> programs;
+  // Only filled in with ParseOptions::skeleton, which leaves the tree and
+  // its counts out.
+  std::vector<Landmark> skeleton;
+  uint32_t bytes = 0;
+  uint32_t node_count = 0;
+  uint32_t error_count = 0;
+  uint32_t missing_count = 0;
+  double parse_ms = 0;
+  // Whether the result was loaded from ParseOptions::cache, in which case
+  // parse_ms is the time the load took.
+  bool cached = false;
+};
+
+// Returns the parser owned by the calling thread, set to `language`.
+// Parsers are created lazily and live as long as the thread does, so libuv
+// pool threads reuse one parser across every file they are handed.
+TSParser *thread_parser(const TSLanguage *language);
+
+bool read_file(const std::string &path, std::string *contents,
+               std::string *error);
+
+// Reads result->path and expands its copybooks when the options ask for it.
+// Returns false with result->error set when the file cannot be read.
+bool load_file(const Grammar &grammar, const ParseOptions &options,
+               ParseResult *result, std::string *source);
+
+void parse_file(const Grammar &grammar, const ParseOptions &options,
+                ParseResult *result);
+
+// Parses `length` bytes of `source` without copying them, in the encoding
+// options.code_page says. Copybooks are not expanded.
+void parse_source(const Grammar &grammar, const ParseOptions &options,
+                  const char *source, uint32_t length, ParseResult *result);
+
+// A list of files or buffers shared by several workers. Each worker calls
+// run(), which claims them one at a time, so large files do not leave the
+// other threads idle the way a static split would.
+//
+// With split_programs, a worker that claims a document with several
+// programs queues one task per program instead of parsing it, and workers
+// take tasks before new documents. The worker finishing a document's last
+// program joins the parts into its result, with offsets in the document.
+class ParseBatch {
+ public:
+  ParseBatch(const Grammar *grammar, const ParseOptions &options,
+             std::vector<std::string> paths);
+  ParseBatch(const Grammar *grammar, const ParseOptions &options,
+             std::vector<SourceBuffer> buffers);
+
+  void run();
+
+  const ParseOptions &options() const { return options_; }
+  std::vector<ParseResult> &results() { return results_; }
+
+ private:
+  struct SplitDocument;
+  struct ProgramTask {
+    std::shared_ptr<SplitDocument> document;
+    size_t program;
+  };
+
+  void run_split();
+  void split(size_t index);
+  void parse_program(const ProgramTask &task);
+
+  const Grammar *grammar_;
+  ParseOptions options_;
+  std::vector<SourceBuffer> buffers_;
+  std::vector<ParseResult> results_;
+  std::atomic<size_t> next_;
+
+  // Only used with split_programs.
+  std::mutex mutex_;
+  std::condition_variable queued_;
+  std::deque<ProgramTask> tasks_;
+  // Workers between claiming a document and queueing its programs.
+  size_t splitting_ = 0;
+};
+
+}  // namespace ts_native
+
+#endif  // TS_NATIVE_BATCH_PARSE_H_
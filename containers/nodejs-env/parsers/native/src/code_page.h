@@ -0,0 +1,59 @@
+#ifndef TS_NATIVE_CODE_PAGE_H_
+#define TS_NATIVE_CODE_PAGE_H_
+
+#include <tree_sitter/api.h>
+
+#include <cstdint>
+#include <string>
+
+namespace ts_native {
+
+// A single-byte code page, EBCDIC in practice: CP037 for the mainframe and
+// Tandem sources, CP1026 for the Turkish ones. Every character it has is in
+// the Basic Multilingual Plane.
+struct CodePage {
+  const char *name;
+  uint16_t to_unicode[256];
+};
+
+// Looks up "cp037"/"ibm037" or "cp1026"/"ibm1026", ignoring case. Returns
+// null for anything else, UTF-8 included.
+const CodePage *find_code_page(const std::string &name);
+
+void append_utf8(uint32_t code_point, std::string *out);
+
+// The next '\n' in [begin, end), or null. With a code page, its newline
+// (NL or LF in EBCDIC) is looked for instead.
+const char *find_line_end(const char *begin, const char *end,
+                          const CodePage *code_page);
+
+// Feeds code-page bytes to the parser as UTF-16, decoding a small chunk per
+// read callback instead of transcoding the whole file first. Each byte
+// becomes one UTF-16 code unit, so byte offsets and columns in the tree are
+// the original ones shifted left by kByteShift.
+class CodePageInput {
+ public:
+  static const uint32_t kByteShift = 1;
+
+  CodePageInput(const CodePage &code_page, const char *data, uint32_t length)
+      : code_page_(code_page), data_(data), length_(length) {}
+
+  TSInput input() {
+    return {this, read, TSInputEncodingUTF16};
+  }
+
+ private:
+  static const uint32_t kChunkSize = 1024;
+
+  static const char *read(void *payload, uint32_t byte_index,
+                          TSPoint position, uint32_t *bytes_read);
+
+  const CodePage &code_page_;
+  const char *data_;
+  uint32_t length_;
+  uint16_t chunk_[kChunkSize];
+};
+
+}  // namespace ts_native
+
+#endif  // TS_NATIVE_CODE_PAGE_H_
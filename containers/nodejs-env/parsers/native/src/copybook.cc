@@ -0,0 +1,925 @@
+#include "copybook.h"
+
+#include "batch_parse.h"
+#include "hash.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace ts_native {
+
+namespace {
+
+const uint32_t kIndicatorColumn = 6;
+const uint32_t kAreaAStart = 7;
+const uint32_t kAreaBStart = 11;
+const uint32_t kAreaBEnd = 72;
+
+// Deeper nesting than this is treated as a COPY cycle the path check missed
+// (the same copybook reached through different directories).
+const int kMaxDepth = 16;
+
+const char *const kDefaultExtensions[] = {
+    "", ".cpy", ".CPY", ".cbl", ".CBL", ".cob", ".COB",
+};
+
+enum TokenKind {
+  kWord,
+  kLiteral,
+  kPeriod,
+  kPseudoTextDelimiter,
+  kPunctuation,
+};
+
+// A COBOL text-word. `text` is the word as the compiler sees it, which for a
+// word continued on a '-' line is not the same as the bytes start..end.
+struct Token {
+  TokenKind kind;
+  uint32_t start;
+  uint32_t end;
+  std::string text;
+};
+
+struct Replacing {
+  enum Mode { kAll, kLeading, kTrailing };
+
+  Mode mode = kAll;
+  std::vector<Token> from;
+  std::vector<Token> to;
+};
+
+struct CopyStatement {
+  uint32_t start;
+  // Just past the terminating period.
+  uint32_t end;
+  std::string name;
+  std::string library;
+  std::vector<Replacing> replacing;
+};
+
+// A span of the file that is emitted differently: blanked (a COPY statement
+// whose copybook is spliced in after it) or replaced (REPLACING).
+struct Change {
+  uint32_t start;
+  uint32_t end;
+  bool blank;
+  std::string text;
+};
+
+typedef std::vector<std::pair<std::string, uint64_t>> Dependencies;
+
+struct CachedCopybook {
+  ExpandedSource expansion;
+  // Every file the expansion was built from with its content hash, the
+  // copybook itself first.
+  Dependencies dependencies;
+};
+
+struct FileContents {
+  std::string text;
+  uint64_t hash;
+  time_t mtime;
+  off_t size;
+};
+
+bool is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+bool is_separator(char c) { return is_space(c) || c == ',' || c == ';'; }
+
+// Colons are split off as well, so that the common `==:TAG:==` convention
+// replaces the tag inside words like `:TAG:-NAME`.
+bool is_punctuation(char c) { return c == '(' || c == ')' || c == ':'; }
+
+bool ends_word(const std::string &visible, size_t i) {
+  char c = visible[i];
+  if (is_separator(c) || is_punctuation(c) || c == '"' || c == '\'') {
+    return true;
+  }
+  bool last = i + 1 == visible.size();
+  if (c == '.') return last || is_separator(visible[i + 1]);
+  return c == '=' && !last && visible[i + 1] == '=';
+}
+
+std::string upper(std::string text) {
+  for (char &c : text) c = toupper(static_cast<unsigned char>(c));
+  return text;
+}
+
+std::string lower(std::string text) {
+  for (char &c : text) c = tolower(static_cast<unsigned char>(c));
+  return text;
+}
+
+bool iequals(const char *a, const char *b, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    if (toupper(static_cast<unsigned char>(a[i])) !=
+        toupper(static_cast<unsigned char>(b[i]))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Words compare case-insensitively, literals exactly.
+bool same_token(const Token &a, const Token &b) {
+  if (a.kind != b.kind || a.text.size() != b.text.size()) return false;
+  if (a.kind == kLiteral) return a.text == b.text;
+  return iequals(a.text.data(), b.text.data(), a.text.size());
+}
+
+bool is_keyword(const Token &token, const char *keyword) {
+  return token.kind == kWord && token.text.size() == strlen(keyword) &&
+         iequals(token.text.data(), keyword, token.text.size());
+}
+
+std::string unquote(const Token &token) {
+  if (token.kind != kLiteral || token.text.size() < 2) return token.text;
+  return token.text.substr(1, token.text.size() - 2);
+}
+
+std::string directory_of(const std::string &path) {
+  size_t slash = path.find_last_of("/\\");
+  if (slash == std::string::npos) return ".";
+  return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+bool is_regular_file(const std::string &path) {
+  struct stat st;
+  return stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+}
+
+// The text the compiler reads: every byte it ignores (sequence, indicator and
+// identification areas, comment lines) becomes a space, so offsets into the
+// result are offsets into the file.
+std::string visible_text(const std::string &text, bool fixed_format) {
+  std::string visible(text);
+  if (!fixed_format) return visible;
+
+  size_t line_start = 0;
+  while (line_start < text.size()) {
+    size_t line_end = text.find('\n', line_start);
+    if (line_end == std::string::npos) line_end = text.size();
+    size_t length = line_end - line_start;
+    char indicator =
+        length > kIndicatorColumn ? text[line_start + kIndicatorColumn] : ' ';
+    size_t keep_start = indicator == '*' || indicator == '/'
+                            ? line_end
+                            : line_start + std::min<size_t>(length, kAreaAStart);
+    size_t keep_end = line_start + std::min<size_t>(length, kAreaBEnd);
+    for (size_t i = line_start; i < line_end; i++) {
+      if (i < keep_start || i >= keep_end) visible[i] = ' ';
+    }
+    line_start = line_end + 1;
+  }
+  return visible;
+}
+
+// If the word ending at `i` is continued on the next line ('-' indicator),
+// sets `resume` to the first nonblank character of that line's area B.
+bool find_continuation(const std::string &text, const std::string &visible,
+                       size_t i, size_t *resume) {
+  while (i < visible.size() && visible[i] != '\n' && is_space(visible[i])) i++;
+  if (i >= visible.size() || visible[i] != '\n') return false;
+
+  size_t line_start = i + 1;
+  size_t line_end = text.find('\n', line_start);
+  if (line_end == std::string::npos) line_end = text.size();
+  if (line_end - line_start <= kIndicatorColumn ||
+      text[line_start + kIndicatorColumn] != '-') {
+    return false;
+  }
+  for (size_t k = line_start + kAreaAStart; k < line_end; k++) {
+    if (!is_space(visible[k])) {
+      *resume = k;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Splits the visible text into text-words. Continued words are joined, but a
+// literal continued across lines comes out as two literals; nothing here
+// compares literals that long.
+std::vector<Token> tokenize(const std::string &text, const std::string &visible,
+                            bool fixed_format) {
+  std::vector<Token> tokens;
+  size_t size = visible.size();
+  size_t i = 0;
+  while (i < size) {
+    char c = visible[i];
+    if (is_separator(c)) {
+      i++;
+      continue;
+    }
+
+    size_t start = i;
+    TokenKind kind;
+    if (c == '"' || c == '\'') {
+      kind = kLiteral;
+      for (i++; i < size && visible[i] != '\n'; i++) {
+        if (visible[i] != c) continue;
+        if (i + 1 < size && visible[i + 1] == c) {
+          i++;
+          continue;
+        }
+        i++;
+        break;
+      }
+    } else if (c == '=' && i + 1 < size && visible[i + 1] == '=') {
+      kind = kPseudoTextDelimiter;
+      i += 2;
+    } else if (c == '.' && (i + 1 == size || is_separator(visible[i + 1]))) {
+      kind = kPeriod;
+      i++;
+    } else if (is_punctuation(c)) {
+      kind = kPunctuation;
+      i++;
+    } else {
+      kind = kWord;
+      std::string word;
+      size_t segment = i;
+      for (;;) {
+        while (i < size && !ends_word(visible, i)) i++;
+        word.append(visible, segment, i - segment);
+        size_t resume;
+        if (!fixed_format || !find_continuation(text, visible, i, &resume)) {
+          break;
+        }
+        i = segment = resume;
+      }
+      tokens.push_back({kind, static_cast<uint32_t>(start),
+                        static_cast<uint32_t>(i), std::move(word)});
+      continue;
+    }
+    tokens.push_back({kind, static_cast<uint32_t>(start),
+                      static_cast<uint32_t>(i),
+                      visible.substr(start, i - start)});
+  }
+  return tokens;
+}
+
+// Reads `==pseudo-text==`, a literal or a word starting at tokens[*i].
+bool parse_operand(const std::vector<Token> &tokens, size_t *i,
+                   std::vector<Token> *operand) {
+  if (*i >= tokens.size()) return false;
+  const Token &first = tokens[*i];
+  if (first.kind == kPseudoTextDelimiter) {
+    size_t close = *i + 1;
+    while (close < tokens.size() && tokens[close].kind != kPseudoTextDelimiter) {
+      close++;
+    }
+    if (close == tokens.size()) return false;
+    operand->assign(tokens.begin() + *i + 1, tokens.begin() + close);
+    *i = close + 1;
+    return true;
+  }
+  if (first.kind == kWord || first.kind == kLiteral) {
+    operand->assign(1, first);
+    *i += 1;
+    return true;
+  }
+  return false;
+}
+
+// Parses the COPY statement whose COPY word is tokens[*i] and moves *i past
+// its period. Returns false, leaving *i alone, for anything malformed.
+bool parse_copy_statement(const std::vector<Token> &tokens, size_t *i,
+                          CopyStatement *statement) {
+  size_t size = tokens.size();
+  size_t j = *i + 1;
+  if (j >= size || (tokens[j].kind != kWord && tokens[j].kind != kLiteral)) {
+    return false;
+  }
+  statement->start = tokens[*i].start;
+  statement->name = unquote(tokens[j++]);
+
+  if (j < size && (is_keyword(tokens[j], "OF") || is_keyword(tokens[j], "IN"))) {
+    if (j + 1 >= size ||
+        (tokens[j + 1].kind != kWord && tokens[j + 1].kind != kLiteral)) {
+      return false;
+    }
+    statement->library = unquote(tokens[j + 1]);
+    j += 2;
+  }
+  if (j < size && is_keyword(tokens[j], "SUPPRESS")) {
+    j++;
+    if (j < size && is_keyword(tokens[j], "PRINTING")) j++;
+  }
+  if (j < size && is_keyword(tokens[j], "REPLACING")) {
+    j++;
+    while (j < size && tokens[j].kind != kPeriod) {
+      Replacing replacing;
+      if (is_keyword(tokens[j], "LEADING")) {
+        replacing.mode = Replacing::kLeading;
+        j++;
+      } else if (is_keyword(tokens[j], "TRAILING")) {
+        replacing.mode = Replacing::kTrailing;
+        j++;
+      }
+      if (!parse_operand(tokens, &j, &replacing.from)) return false;
+      if (j >= size || !is_keyword(tokens[j], "BY")) return false;
+      j++;
+      if (!parse_operand(tokens, &j, &replacing.to)) return false;
+
+      if (replacing.from.empty()) return false;
+      if (replacing.mode != Replacing::kAll &&
+          (replacing.from.size() != 1 || replacing.from[0].kind != kWord ||
+           replacing.to.size() > 1)) {
+        return false;
+      }
+      statement->replacing.push_back(std::move(replacing));
+    }
+    if (statement->replacing.empty()) return false;
+  }
+  if (j >= size || tokens[j].kind != kPeriod) return false;
+
+  statement->end = tokens[j].end;
+  *i = j + 1;
+  return true;
+}
+
+std::string join_tokens(const std::vector<Token> &tokens) {
+  std::string text;
+  for (const Token &token : tokens) {
+    if (!text.empty()) text += ' ';
+    text += token.text;
+  }
+  return text;
+}
+
+// Identifies a REPLACING phrase for the cache key. Words are upper-cased
+// since they match case-insensitively.
+std::string replacing_key(const std::vector<Replacing> &replacing) {
+  std::string key;
+  for (const Replacing &r : replacing) {
+    key += static_cast<char>('0' + r.mode);
+    for (const Token &token : r.from) {
+      key += token.kind == kLiteral ? token.text : upper(token.text);
+      key += '\0';
+    }
+    key += '\1';
+    key += join_tokens(r.to);
+    key += '\2';
+  }
+  return key;
+}
+
+// Applies a REPLACING phrase to one run of text-words uninterrupted by COPY
+// statements. Replaced text is not searched again.
+void add_replacing_changes(const std::vector<Token> &tokens,
+                           const std::vector<Replacing> &replacing,
+                           std::vector<Change> *changes) {
+  for (size_t i = 0; i < tokens.size();) {
+    size_t matched = 0;
+    for (const Replacing &r : replacing) {
+      if (r.mode == Replacing::kAll) {
+        size_t n = r.from.size();
+        if (i + n > tokens.size()) continue;
+        size_t k = 0;
+        while (k < n && same_token(tokens[i + k], r.from[k])) k++;
+        if (k < n) continue;
+        changes->push_back({tokens[i].start, tokens[i + n - 1].end, false,
+                            join_tokens(r.to)});
+        matched = n;
+        break;
+      }
+
+      // LEADING and TRAILING replace part of a single word, which only has
+      // a byte range when the word is not continued across lines.
+      const Token &token = tokens[i];
+      const std::string &from = r.from[0].text;
+      if (token.kind != kWord || token.end - token.start != token.text.size() ||
+          from.size() > token.text.size()) {
+        continue;
+      }
+      size_t at = r.mode == Replacing::kLeading ? 0 : token.text.size() - from.size();
+      if (!iequals(token.text.data() + at, from.data(), from.size())) continue;
+      uint32_t start = token.start + at;
+      changes->push_back({start, static_cast<uint32_t>(start + from.size()),
+                          false, join_tokens(r.to)});
+      matched = 1;
+      break;
+    }
+    i += matched ? matched : 1;
+  }
+}
+
+// Appends text and its source map to an ExpandedSource.
+class Builder {
+ public:
+  explicit Builder(ExpandedSource *out) : out_(out) {}
+
+  void add(const char *data, size_t length, uint32_t file,
+           uint32_t original_start, uint32_t original_length) {
+    if (length == 0) return;
+    uint32_t start = static_cast<uint32_t>(out_->text.size());
+    out_->text.append(data, length);
+
+    std::vector<SourceMapSegment> &segments = out_->segments;
+    bool verbatim = length == original_length;
+    if (verbatim && !segments.empty()) {
+      SourceMapSegment &last = segments.back();
+      if (last.file == file &&
+          last.expanded_length == last.original_length &&
+          last.expanded_start + last.expanded_length == start &&
+          last.original_start + last.original_length == original_start) {
+        last.expanded_length += length;
+        last.original_length += length;
+        return;
+      }
+    }
+    segments.push_back({start, static_cast<uint32_t>(length), file,
+                        original_start, original_length});
+  }
+
+  void copy(const std::string &text, uint32_t start, uint32_t end) {
+    add(text.data() + start, end - start, 0, start, end - start);
+  }
+
+  // Keeps whatever follows on a line of its own.
+  void end_line(uint32_t original_offset) {
+    if (!out_->text.empty() && out_->text.back() != '\n') {
+      add("\n", 1, 0, original_offset, 0);
+    }
+  }
+
+  // Splices in an expanded copybook, renumbering its files.
+  void append(const ExpandedSource &child) {
+    std::vector<uint32_t> files(child.files.size());
+    for (size_t i = 0; i < child.files.size(); i++) {
+      auto it = std::find(out_->files.begin(), out_->files.end(), child.files[i]);
+      files[i] = static_cast<uint32_t>(it - out_->files.begin());
+      if (it == out_->files.end()) out_->files.push_back(child.files[i]);
+    }
+
+    uint32_t shift = static_cast<uint32_t>(out_->text.size());
+    out_->text += child.text;
+    for (const SourceMapSegment &segment : child.segments) {
+      out_->segments.push_back({segment.expanded_start + shift,
+                                segment.expanded_length, files[segment.file],
+                                segment.original_start,
+                                segment.original_length});
+    }
+    for (const CopyError &error : child.errors) {
+      out_->errors.push_back({files[error.file], error.offset, error.message});
+    }
+  }
+
+ private:
+  ExpandedSource *out_;
+};
+
+// Part of an output line, with where it came from.
+struct Piece {
+  std::string text;
+  uint32_t original_start;
+  uint32_t original_length;
+};
+
+// Where to break a line that REPLACING pushed past column 72: runs of spaces
+// outside literals, each replaced by a newline and an indent to area B.
+std::vector<std::pair<size_t, size_t>> find_line_breaks(const std::string &line) {
+  std::vector<std::pair<size_t, size_t>> breaks;
+  size_t content_end = line.size();
+  while (content_end > 0 && (line[content_end - 1] == '\n' ||
+                             line[content_end - 1] == '\r')) {
+    content_end--;
+  }
+  if (content_end <= kAreaBEnd) return breaks;
+
+  std::vector<bool> in_literal(content_end, false);
+  char quote = 0;
+  for (size_t i = kAreaAStart; i < content_end; i++) {
+    if (quote) {
+      in_literal[i] = true;
+      if (line[i] == quote) quote = 0;
+    } else if (line[i] == '"' || line[i] == '\'') {
+      in_literal[i] = true;
+      quote = line[i];
+    }
+  }
+
+  size_t start = 0;
+  size_t indent = 0;
+  while (indent + content_end - start > kAreaBEnd) {
+    size_t lower = start == 0 ? kAreaBStart : start;
+    size_t b = start + kAreaBEnd - indent;
+    while (b > lower && (line[b] != ' ' || in_literal[b])) b--;
+    if (b <= lower) break;
+
+    size_t end = b;
+    while (b > lower && line[b - 1] == ' ') b--;
+    while (end < content_end && line[end] == ' ') end++;
+    breaks.push_back({b, end});
+    start = end;
+    indent = kAreaBStart;
+  }
+  return breaks;
+}
+
+void emit_pieces(const std::vector<Piece> &pieces, bool reflow,
+                 Builder *builder) {
+  std::vector<std::pair<size_t, size_t>> breaks;
+  if (reflow) {
+    std::string line;
+    for (const Piece &piece : pieces) line += piece.text;
+    breaks = find_line_breaks(line);
+  }
+
+  static const std::string kIndent = "\n" + std::string(kAreaBStart, ' ');
+  size_t k = 0;
+  size_t position = 0;
+  for (const Piece &piece : pieces) {
+    size_t length = piece.text.size();
+    bool verbatim = length == piece.original_length;
+    size_t i = 0;
+    while (i < length) {
+      size_t at = position + i;
+      uint32_t original = piece.original_start + (verbatim ? i : 0);
+      if (k < breaks.size() && breaks[k].first <= at) {
+        if (at == breaks[k].first) {
+          builder->add(kIndent.data(), kIndent.size(), 0, original, 0);
+        }
+        i = std::min(length, breaks[k].second - position);
+        if (breaks[k].second <= position + length) k++;
+        continue;
+      }
+      size_t stop = k < breaks.size()
+                        ? std::min(length, breaks[k].first - position)
+                        : length;
+      builder->add(piece.text.data() + i, stop - i, 0, original,
+                   verbatim ? stop - i : piece.original_length);
+      i = stop;
+    }
+    position += length;
+  }
+}
+
+// Emits a line that a change touches. Blanked COPY statements keep every
+// column where it was. Replaced text may change length, so such lines lose
+// their identification area, keep the words after a replacement at least at
+// their original column, and are continued in area B if they grow past 72.
+void emit_changed_line(const std::string &text, uint32_t line_start,
+                       uint32_t line_end, uint32_t next,
+                       const std::vector<Change> &changes, size_t *c,
+                       Builder *builder) {
+  bool reflow = false;
+  for (size_t k = *c; k < changes.size() && changes[k].start < next; k++) {
+    if (!changes[k].blank) reflow = true;
+  }
+  uint32_t area_end =
+      reflow ? std::min(line_end, line_start + kAreaBEnd) : line_end;
+
+  std::vector<Piece> pieces;
+  size_t column = 0;
+  uint32_t p = line_start;
+  while (p < area_end) {
+    const Change *change = *c < changes.size() ? &changes[*c] : nullptr;
+    if (change && change->start <= p) {
+      uint32_t portion_end = std::min(change->end, area_end);
+      if (change->blank) {
+        pieces.push_back({std::string(portion_end - p, ' '), p, portion_end - p});
+        column += portion_end - p;
+      } else if (p == change->start) {
+        pieces.push_back({change->text, change->start, change->end - change->start});
+        column += change->text.size();
+      }
+      if (change->end <= area_end) (*c)++;
+      p = portion_end;
+      continue;
+    }
+
+    uint32_t stop = change ? std::min(area_end, change->start) : area_end;
+    // Padding never splits a word that a replacement ends in the middle of.
+    size_t original_column = p - line_start;
+    if (column < original_column && (pieces.empty() || is_space(text[p - 1]))) {
+      pieces.push_back({std::string(original_column - column, ' '), p, 0});
+      column = original_column;
+    }
+    pieces.push_back({text.substr(p, stop - p), p, stop - p});
+    column += stop - p;
+    p = stop;
+  }
+  if (next > line_end) pieces.push_back({"\n", line_end, 1});
+  emit_pieces(pieces, reflow, builder);
+}
+
+class CopybookCache {
+ public:
+  // Never destroyed, so pool threads still parsing at exit can use it.
+  static CopybookCache &shared() {
+    static CopybookCache *cache = new CopybookCache();
+    return *cache;
+  }
+
+  // Files are re-read only when their size or mtime changes.
+  std::shared_ptr<const FileContents> read(const std::string &path,
+                                           std::string *error) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+      *error = "cannot open " + path + ": " + strerror(errno);
+      return nullptr;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = files_.find(path);
+      if (it != files_.end() && it->second->size == st.st_size &&
+          it->second->mtime == st.st_mtime) {
+        return it->second;
+      }
+    }
+
+    auto contents = std::make_shared<FileContents>();
+    if (!read_file(path, &contents->text, error)) return nullptr;
+    contents->hash = fnv1a(contents->text);
+    contents->mtime = st.st_mtime;
+    contents->size = st.st_size;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    files_[path] = contents;
+    return contents;
+  }
+
+  // Only successful lookups are remembered, so a copybook added later is
+  // still found.
+  bool resolved(const std::string &key, std::string *path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = paths_.find(key);
+    if (it == paths_.end()) return false;
+    *path = it->second;
+    return true;
+  }
+
+  void set_resolved(const std::string &key, const std::string &path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    paths_[key] = path;
+  }
+
+  std::shared_ptr<const CachedCopybook> find(const std::string &key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = copybooks_.find(key);
+    return it == copybooks_.end() ? nullptr : it->second;
+  }
+
+  // Two threads may expand the same copybook at once; both results are
+  // equivalent and the later one simply replaces the earlier.
+  void insert(const std::string &key,
+              std::shared_ptr<const CachedCopybook> copybook) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    copybooks_[key] = std::move(copybook);
+  }
+
+ private:
+  CopybookCache() {}
+
+  std::mutex mutex_;
+  std::unordered_map<std::string, std::shared_ptr<const FileContents>> files_;
+  std::unordered_map<std::string, std::string> paths_;
+  std::unordered_map<std::string, std::shared_ptr<const CachedCopybook>>
+      copybooks_;
+};
+
+// Expands one program. Copybooks come from, and go to, the shared cache.
+class Expander {
+ public:
+  explicit Expander(const CopybookOptions &options)
+      : options_(options), cache_(CopybookCache::shared()) {
+    if (options_.extensions.empty()) {
+      options_.extensions.assign(std::begin(kDefaultExtensions),
+                                 std::end(kDefaultExtensions));
+    }
+    options_key_ = options_.fixed_format ? "F" : "V";
+    for (const std::string &directory : options_.directories) {
+      options_key_ += '\0' + directory;
+    }
+    options_key_ += '\1';
+    for (const std::string &extension : options_.extensions) {
+      options_key_ += '\0' + extension;
+    }
+    options_key_ += '\2';
+  }
+
+  void expand(const std::string &path, const std::string &text,
+              const std::vector<Replacing> &replacing, int depth,
+              ExpandedSource *out, Dependencies *dependencies);
+
+ private:
+  std::shared_ptr<const CachedCopybook> copybook(
+      const CopyStatement &statement, const std::string &including_path,
+      int depth, std::string *error);
+  bool resolve(const CopyStatement &statement,
+               const std::string &including_path, std::string *path);
+  bool fresh(const CachedCopybook &copybook);
+
+  CopybookOptions options_;
+  // The options as a prefix of the cache keys, which are compared whole.
+  std::string options_key_;
+  CopybookCache &cache_;
+  // Copybooks being expanded, outermost first, to report COPY cycles.
+  std::vector<std::string> stack_;
+};
+
+bool Expander::resolve(const CopyStatement &statement,
+                       const std::string &including_path, std::string *path) {
+  std::string including_directory = directory_of(including_path);
+  std::string key = options_key_ + including_directory + '\0' +
+                    statement.library + '\0' + statement.name;
+  if (cache_.resolved(key, path)) return true;
+
+  std::vector<std::string> names = {statement.name};
+  for (const std::string &name : {upper(statement.name), lower(statement.name)}) {
+    if (std::find(names.begin(), names.end(), name) == names.end()) {
+      names.push_back(name);
+    }
+  }
+
+  std::vector<std::string> bases;
+  if (statement.name[0] == '/') {
+    bases.push_back("");
+  } else {
+    std::vector<std::string> directories = {including_directory};
+    directories.insert(directories.end(), options_.directories.begin(),
+                       options_.directories.end());
+    for (const std::string &directory : directories) {
+      if (!statement.library.empty()) {
+        bases.push_back(directory + "/" + statement.library + "/");
+      }
+      bases.push_back(directory + "/");
+    }
+  }
+
+  for (const std::string &base : bases) {
+    for (const std::string &name : names) {
+      for (const std::string &extension : options_.extensions) {
+        std::string candidate = base + name + extension;
+        if (is_regular_file(candidate)) {
+          cache_.set_resolved(key, candidate);
+          *path = candidate;
+          return true;
+        }
+      }
+    }
+  }
+  return false;
+}
+
+bool Expander::fresh(const CachedCopybook &copybook) {
+  for (size_t i = 1; i < copybook.dependencies.size(); i++) {
+    std::string error;
+    auto contents = cache_.read(copybook.dependencies[i].first, &error);
+    if (!contents || contents->hash != copybook.dependencies[i].second) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::shared_ptr<const CachedCopybook> Expander::copybook(
+    const CopyStatement &statement, const std::string &including_path,
+    int depth, std::string *error) {
+  std::string path;
+  if (!resolve(statement, including_path, &path)) {
+    *error = "copybook " + statement.name + " not found";
+    return nullptr;
+  }
+  if (depth >= kMaxDepth ||
+      std::find(stack_.begin(), stack_.end(), path) != stack_.end()) {
+    *error = "recursive COPY of " + path;
+    return nullptr;
+  }
+  std::shared_ptr<const FileContents> contents = cache_.read(path, error);
+  if (!contents) return nullptr;
+
+  // The path, rather than the content, is the key because nested COPY
+  // statements are looked up relative to its directory. The content hash
+  // only tells whether a cached expansion is still current.
+  std::string key =
+      options_key_ + path + '\0' + replacing_key(statement.replacing);
+  std::shared_ptr<const CachedCopybook> cached = cache_.find(key);
+  if (cached && cached->dependencies[0].second == contents->hash &&
+      fresh(*cached)) {
+    return cached;
+  }
+
+  auto copybook = std::make_shared<CachedCopybook>();
+  copybook->dependencies.push_back({path, contents->hash});
+  stack_.push_back(path);
+  expand(path, contents->text, statement.replacing, depth + 1,
+         &copybook->expansion, &copybook->dependencies);
+  stack_.pop_back();
+
+  // A copybook with errors may expand differently once its nested
+  // copybooks turn up, so it is not shared.
+  if (copybook->expansion.errors.empty()) cache_.insert(key, copybook);
+  return copybook;
+}
+
+void Expander::expand(const std::string &path, const std::string &text,
+                      const std::vector<Replacing> &replacing, int depth,
+                      ExpandedSource *out, Dependencies *dependencies) {
+  out->files.push_back(path);
+  std::string visible = visible_text(text, options_.fixed_format);
+  std::vector<Token> tokens = tokenize(text, visible, options_.fixed_format);
+
+  std::vector<Change> changes;
+  std::vector<std::pair<uint32_t, std::shared_ptr<const CachedCopybook>>> inserts;
+  std::vector<Token> run;
+  for (size_t i = 0; i < tokens.size();) {
+    CopyStatement statement;
+    if (!is_keyword(tokens[i], "COPY")) {
+      run.push_back(tokens[i++]);
+      continue;
+    }
+    if (!parse_copy_statement(tokens, &i, &statement)) {
+      out->errors.push_back({0, tokens[i].start, "malformed COPY statement"});
+      run.push_back(tokens[i++]);
+      continue;
+    }
+
+    add_replacing_changes(run, replacing, &changes);
+    run.clear();
+
+    std::string error;
+    std::shared_ptr<const CachedCopybook> copybook =
+        this->copybook(statement, path, depth, &error);
+    if (!copybook) {
+      out->errors.push_back({0, statement.start, error});
+      continue;
+    }
+    changes.push_back({statement.start, statement.end, true, std::string()});
+    inserts.push_back({statement.end, copybook});
+    dependencies->insert(dependencies->end(),
+                         copybook->dependencies.begin(),
+                         copybook->dependencies.end());
+  }
+  add_replacing_changes(run, replacing, &changes);
+  std::sort(changes.begin(), changes.end(),
+            [](const Change &a, const Change &b) { return a.start < b.start; });
+
+  Builder builder(out);
+  size_t c = 0;
+  size_t n = 0;
+  uint32_t size = static_cast<uint32_t>(text.size());
+  uint32_t line_start = 0;
+  while (line_start < size) {
+    const char *newline = static_cast<const char *>(
+        memchr(text.data() + line_start, '\n', size - line_start));
+    uint32_t line_end = newline ? newline - text.data() : size;
+    uint32_t next = newline ? line_end + 1 : size;
+
+    if (c < changes.size() && changes[c].start < next) {
+      emit_changed_line(text, line_start, line_end, next, changes, &c,
+                        &builder);
+    } else {
+      builder.copy(text, line_start, next);
+    }
+
+    for (; n < inserts.size() && inserts[n].first <= next; n++) {
+      builder.end_line(inserts[n].first);
+      builder.append(inserts[n].second->expansion);
+      builder.end_line(inserts[n].first);
+    }
+    line_start = next;
+  }
+}
+
+}  // namespace
+
+bool ExpandedSource::original_position(uint32_t offset, uint32_t *file,
+                                       uint32_t *original) const {
+  auto it = std::upper_bound(
+      segments.begin(), segments.end(), offset,
+      [](uint32_t offset, const SourceMapSegment &segment) {
+        return offset < segment.expanded_start;
+      });
+  if (it == segments.begin()) return false;
+  const SourceMapSegment &segment = *--it;
+  if (offset >= segment.expanded_start + segment.expanded_length) return false;
+
+  *file = segment.file;
+  *original = segment.original_start;
+  if (segment.expanded_length == segment.original_length) {
+    *original += offset - segment.expanded_start;
+  }
+  return true;
+}
+
+void expand_copybooks(const std::string &path, const std::string &text,
+                      const CopybookOptions &options, ExpandedSource *out) {
+  *out = ExpandedSource();
+  Dependencies dependencies;
+  Expander(options).expand(path, text, std::vector<Replacing>(), 0, out,
+                           &dependencies);
+}
+
+}  // namespace ts_native
@@ -0,0 +1,64 @@
+#ifndef TS_NATIVE_COPYBOOK_H_
+#define TS_NATIVE_COPYBOOK_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ts_native {
+
+struct CopybookOptions {
+  // Searched after the directory of the including file, in order.
+  std::vector<std::string> directories;
+  // Tried in order for every candidate name; defaults are used when empty.
+  std::vector<std::string> extensions;
+  bool fixed_format = true;
+};
+
+// Maps `expanded_length` bytes of the expanded text back to a file. When the
+// two lengths are equal the bytes are a verbatim copy and map one to one;
+// otherwise (REPLACING, reflowed lines) every byte maps to original_start.
+struct SourceMapSegment {
+  uint32_t expanded_start;
+  uint32_t expanded_length;
+  uint32_t file;
+  uint32_t original_start;
+  uint32_t original_length;
+};
+
+struct CopyError {
+  uint32_t file;
+  uint32_t offset;
+  std::string message;
+};
+
+struct ExpandedSource {
+  std::string text;
+  // files[0] is the program itself, copybooks follow in first-use order.
+  std::vector<std::string> files;
+  // Sorted by expanded_start and covering all of `text`.
+  std::vector<SourceMapSegment> segments;
+  std::vector<CopyError> errors;
+
+  // Maps an offset in `text` back to a file index and an offset in that file.
+  bool original_position(uint32_t offset, uint32_t *file,
+                         uint32_t *original) const;
+};
+
+// Expands `COPY name [OF|IN lib] [SUPPRESS] [REPLACING ...]` statements in
+// `text`, the contents of `path`.
+//
+// The COPY statement is blanked in place and the copybook's lines are spliced
+// in after the line that ends it, so the result is still fixed format. Each
+// copybook is expanded once per process for a given content, REPLACING set
+// and search path and then shared by every program and thread that copies
+// it. REPLACING applies to the copybook's own text; COPY statements nested in
+// a copybook are expanded with their own REPLACING phrase. Copybooks that
+// cannot be found are reported in `errors` and their COPY statements are
+// left untouched.
+void expand_copybooks(const std::string &path, const std::string &text,
+                      const CopybookOptions &options, ExpandedSource *out);
+
+}  // namespace ts_native
+
+#endif  // TS_NATIVE_COPYBOOK_H_
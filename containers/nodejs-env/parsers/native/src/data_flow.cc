@@ -0,0 +1,342 @@
+#include "data_flow.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace ts_native {
+
+namespace {
+
+enum : uint8_t {
+  kStatement = 1 << 0,
+  kReference = 1 << 1,
+  kSubscript = 1 << 2,
+  kSkipped = 1 << 3,
+};
+
+// DataFlowRules resolved against one language: flags per symbol and the
+// operands keyed by (parent symbol << 16 | field id).
+struct Tables {
+  std::vector<uint8_t> kinds;
+  std::unordered_map<uint32_t, const DataFlowOperand *> operands;
+
+  uint8_t kind(TSSymbol symbol) const {
+    return symbol < kinds.size() ? kinds[symbol] : 0;
+  }
+};
+
+bool listed(const char *const *names, const char *name) {
+  for (; *names; names++) {
+    if (strcmp(*names, name) == 0) return true;
+  }
+  return false;
+}
+
+Tables *resolve(const TSLanguage *language, const DataFlowRules &rules) {
+  Tables *tables = new Tables();
+  uint32_t symbol_count = ts_language_symbol_count(language);
+  tables->kinds.resize(symbol_count);
+
+  // By scanning every symbol rather than looking names up, aliases that
+  // share a name with another symbol are flagged too.
+  std::unordered_map<std::string, std::vector<TSSymbol>> symbols;
+  for (TSSymbol symbol = 0; symbol < symbol_count; symbol++) {
+    if (ts_language_symbol_type(language, symbol) != TSSymbolTypeRegular) {
+      continue;
+    }
+    const char *name = ts_language_symbol_name(language, symbol);
+    if (!name) continue;
+    uint8_t &kind = tables->kinds[symbol];
+    if (listed(rules.statements, name)) kind |= kStatement;
+    if (listed(rules.references, name)) kind |= kReference;
+    if (listed(rules.subscripts, name)) kind |= kSubscript;
+    if (listed(rules.skipped, name)) kind |= kSkipped;
+    symbols[name].push_back(symbol);
+  }
+
+  for (const DataFlowOperand *operand = rules.operands; operand->parent;
+       operand++) {
+    TSFieldId field = ts_language_field_id_for_name(
+        language, operand->field, strlen(operand->field));
+    auto it = symbols.find(operand->parent);
+    if (field == 0 || it == symbols.end()) continue;
+    for (TSSymbol symbol : it->second) {
+      tables->operands[static_cast<uint32_t>(symbol) << 16 | field] = operand;
+    }
+  }
+  return tables;
+}
+
+// Resolved once per language and rule set, and never freed, like the
+// grammars they describe.
+const Tables &tables_for(const TSLanguage *language,
+                         const DataFlowRules &rules) {
+  static std::mutex *mutex = new std::mutex();
+  static auto *cache =
+      new std::map<std::pair<const TSLanguage *, const DataFlowRules *>,
+                   Tables *>();
+  std::lock_guard<std::mutex> lock(*mutex);
+  Tables *&tables = (*cache)[{language, &rules}];
+  if (!tables) tables = resolve(language, rules);
+  return *tables;
+}
+
+struct Reference {
+  uint32_t token;
+  uint32_t variable;
+  OperandRole role;
+};
+
+// One node on the cursor path.
+struct Frame {
+  TSSymbol symbol;
+  OperandRole role;
+  bool statement;
+  // Whether this node starts a data reference, and whether it is inside one.
+  bool reference;
+  bool in_reference;
+  bool subscript;
+  uint32_t first_token;
+};
+
+class Extractor {
+ public:
+  Extractor(const Tables &tables, const char *source,
+            const CodePage *code_page, DataFlowGraph *graph)
+      : tables_(tables),
+        source_(source),
+        code_page_(code_page),
+        byte_shift_(code_page ? CodePageInput::kByteShift : 0),
+        graph_(graph) {}
+
+  void run(TSNode root) {
+    TSTreeCursor cursor = ts_tree_cursor_new(root);
+    for (;;) {
+      TSNode node = ts_tree_cursor_current_node(&cursor);
+      bool skipped = enter(node, ts_tree_cursor_current_field_id(&cursor));
+      if (!skipped && ts_tree_cursor_goto_first_child(&cursor)) continue;
+      if (!skipped && ts_node_child_count(node) == 0) add_token(node);
+      leave();
+      while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+        if (!ts_tree_cursor_goto_parent(&cursor)) {
+          ts_tree_cursor_delete(&cursor);
+          finish();
+          return;
+        }
+        leave();
+      }
+    }
+  }
+
+ private:
+  // Pushes the frame of `node` and returns whether its subtree is skipped.
+  bool enter(TSNode node, TSFieldId field) {
+    TSSymbol symbol = ts_node_symbol(node);
+    uint8_t kind = tables_.kind(symbol);
+    Frame frame = {symbol, OperandRole::kUse, false, false, false, false,
+                   static_cast<uint32_t>(graph_->tokens.size())};
+    if (kind & kSkipped) {
+      frames_.push_back(frame);
+      return true;
+    }
+
+    bool operand_reference = false;
+    if (!frames_.empty()) {
+      const Frame &parent = frames_.back();
+      frame.role = parent.role;
+      frame.in_reference = parent.in_reference;
+      if (parent.subscript) {
+        frame.role = OperandRole::kUse;
+      } else if (field != 0) {
+        auto it = tables_.operands.find(
+            static_cast<uint32_t>(parent.symbol) << 16 | field);
+        if (it != tables_.operands.end()) {
+          frame.role = it->second->role;
+          operand_reference = it->second->reference;
+        }
+      }
+    }
+
+    if (kind & kStatement) {
+      // Operands before a nested statement (ADD ... ON SIZE ERROR MOVE ...)
+      // are settled before the nested one reads them.
+      if (!statements_.empty()) flush(&statements_.back());
+      statements_.emplace_back();
+      frame.statement = true;
+      frame.role = OperandRole::kUse;
+      frame.in_reference = false;
+    }
+    if (kind & kSubscript) {
+      frame.subscript = true;
+      frame.in_reference = false;
+    }
+    if (!frame.in_reference && frame.role != OperandRole::kIgnore &&
+        ((kind & kReference) || operand_reference)) {
+      frame.reference = true;
+      frame.in_reference = true;
+    }
+    frames_.push_back(frame);
+    return false;
+  }
+
+  void leave() {
+    Frame frame = frames_.back();
+    frames_.pop_back();
+    uint32_t token_count = static_cast<uint32_t>(graph_->tokens.size());
+    if (frame.reference && token_count > frame.first_token) {
+      Reference reference = {
+          frame.first_token, variable(frame.first_token, token_count),
+          frame.role};
+      if (statements_.empty()) {
+        read(reference);
+      } else {
+        statements_.back().push_back(reference);
+      }
+    }
+    if (frame.statement) {
+      flush(&statements_.back());
+      statements_.pop_back();
+    }
+  }
+
+  uint32_t character(uint32_t byte) const {
+    unsigned char c = source_[byte];
+    return code_page_ ? code_page_->to_unicode[c] : c;
+  }
+
+  void add_token(TSNode node) {
+    uint32_t start = ts_node_start_byte(node) >> byte_shift_;
+    uint32_t end = ts_node_end_byte(node) >> byte_shift_;
+    // Missing nodes and the newline tokens some grammars produce are not
+    // code tokens.
+    uint32_t i = start;
+    while (i < end && character(i) < 0x80 && isspace(character(i))) i++;
+    if (i == end) return;
+
+    TSPoint start_point = ts_node_start_point(node);
+    TSPoint end_point = ts_node_end_point(node);
+    graph_->tokens.push_back({start, end, start_point.row,
+                              start_point.column >> byte_shift_, end_point.row,
+                              end_point.column >> byte_shift_});
+  }
+
+  uint32_t variable(uint32_t first_token, uint32_t end_token) {
+    std::string name;
+    for (uint32_t i = first_token; i < end_token; i++) {
+      const DataFlowToken &token = graph_->tokens[i];
+      if (!name.empty()) name += ' ';
+      for (uint32_t j = token.start_byte; j < token.end_byte; j++) {
+        uint32_t c = character(j);
+        if (c < 0x80) {
+          name += static_cast<char>(toupper(c));
+        } else if (code_page_) {
+          append_utf8(c, &name);
+        } else {
+          name += static_cast<char>(c);
+        }
+      }
+    }
+    auto inserted = variable_ids_.emplace(
+        name, static_cast<uint32_t>(graph_->variables.size()));
+    if (inserted.second) {
+      graph_->variables.push_back(std::move(name));
+      definitions_.emplace_back();
+    }
+    return inserted.first->second;
+  }
+
+  void add_edge(const Reference &reference, DataFlowRelation relation,
+                const std::vector<uint32_t> &sources) {
+    graph_->edges.push_back(
+        {reference.token, reference.variable, relation,
+         static_cast<uint32_t>(graph_->sources.size()),
+         static_cast<uint32_t>(sources.size())});
+    graph_->sources.insert(graph_->sources.end(), sources.begin(),
+                           sources.end());
+  }
+
+  // A variable read before anything defined it counts as defined where it
+  // is first read, so later reads come from there.
+  void read(const Reference &reference) {
+    std::vector<uint32_t> &definitions = definitions_[reference.variable];
+    add_edge(reference, kComesFrom, definitions);
+    if (definitions.empty()) definitions.push_back(reference.token);
+  }
+
+  void flush(std::vector<Reference> *statement) {
+    bool has_def = false;
+    for (const Reference &reference : *statement) {
+      if (reference.role == OperandRole::kDef) has_def = true;
+    }
+
+    std::vector<uint32_t> reads;
+    for (const Reference &reference : *statement) {
+      if (reference.role == OperandRole::kUse ||
+          (reference.role == OperandRole::kUseDef && has_def)) {
+        read(reference);
+        reads.push_back(reference.token);
+      }
+    }
+
+    std::vector<const Reference *> defined;
+    std::vector<uint32_t> sources;
+    for (const Reference &reference : *statement) {
+      if (reference.role == OperandRole::kDef) {
+        add_edge(reference, kComputedFrom, reads);
+      } else if (reference.role == OperandRole::kUseDef && !has_def) {
+        // ADD A TO B: B is computed from A and from its own last value.
+        sources = reads;
+        const std::vector<uint32_t> &previous = definitions_[reference.variable];
+        sources.insert(sources.end(), previous.begin(), previous.end());
+        add_edge(reference, kComputedFrom, sources);
+      } else {
+        continue;
+      }
+      defined.push_back(&reference);
+    }
+
+    // Every definition a statement makes survives it, COMPUTE A A = ...
+    // included.
+    for (const Reference *reference : defined) {
+      definitions_[reference->variable].clear();
+    }
+    for (const Reference *reference : defined) {
+      definitions_[reference->variable].push_back(reference->token);
+    }
+    statement->clear();
+  }
+
+  void finish() {
+    std::stable_sort(graph_->edges.begin(), graph_->edges.end(),
+                     [](const DataFlowEdge &a, const DataFlowEdge &b) {
+                       return a.token < b.token;
+                     });
+  }
+
+  const Tables &tables_;
+  const char *source_;
+  const CodePage *code_page_;
+  uint32_t byte_shift_;
+  DataFlowGraph *graph_;
+  std::vector<Frame> frames_;
+  // References waiting for their statement to end, innermost last.
+  std::vector<std::vector<Reference>> statements_;
+  std::unordered_map<std::string, uint32_t> variable_ids_;
+  // Tokens of the definitions each variable's next read comes from.
+  std::vector<std::vector<uint32_t>> definitions_;
+};
+
+}  // namespace
+
+void extract_data_flow(const TSLanguage *language, const DataFlowRules &rules,
+                       TSNode root, const char *source,
+                       const CodePage *code_page, DataFlowGraph *graph) {
+  Extractor(tables_for(language, rules), source, code_page, graph).run(root);
+}
+
+}  // namespace ts_native
@@ -0,0 +1,99 @@
+#ifndef TS_NATIVE_DATA_FLOW_H_
+#define TS_NATIVE_DATA_FLOW_H_
+
+#include <tree_sitter/api.h>
+
+#include "code_page.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ts_native {
+
+// How a statement uses the data references under one of its fields.
+enum class OperandRole : uint8_t {
+  kUse,
+  kDef,
+  // Read and written, like the TO operands of ADD A TO B; only read when the
+  // statement also has kDef operands (ADD A TO B GIVING C).
+  kUseDef,
+  kIgnore,
+};
+
+// The role of the nodes a `parent` node has under `field`. With `reference`
+// set, such a node is a data reference whatever its type (CoolGen view
+// names are plain identifiers).
+struct DataFlowOperand {
+  const char *parent;
+  const char *field;
+  OperandRole role;
+  bool reference;
+};
+
+// What a grammar's data flow is made of, by node type name. Each list ends
+// with a null entry, `operands` with a null parent.
+//
+//   statements   nodes whose operands flow into each other
+//   references   nodes that name one variable, e.g. COBOL's qualified_word
+//   subscripts   nodes whose references are read even inside a target
+//   skipped      nodes left out of the tokens, like comments
+//
+// Nodes outside any operand are reads, as they are in GraphCodeBERT.
+struct DataFlowRules {
+  const char *const *statements;
+  const char *const *references;
+  const char *const *subscripts;
+  const char *const *skipped;
+  const DataFlowOperand *operands;
+};
+
+struct DataFlowToken {
+  uint32_t start_byte;
+  uint32_t end_byte;
+  uint32_t start_row;
+  uint32_t start_column;
+  uint32_t end_row;
+  uint32_t end_column;
+};
+
+enum DataFlowRelation : uint32_t {
+  kComesFrom = 0,
+  kComputedFrom = 1,
+};
+
+// One edge per data reference, anchored at its first token: a read comes
+// from the last definitions of its variable, a definition is computed from
+// the reads of the same statement. `sources` of the graph holds the source
+// token indices, source_count of them starting at first_source.
+struct DataFlowEdge {
+  uint32_t token;
+  uint32_t variable;
+  uint32_t relation;
+  uint32_t first_source;
+  uint32_t source_count;
+};
+
+// The leaf tokens of a tree and the data flow between them, the same data
+// GraphCodeBERT's DFG_* functions build from tree_to_token_index and
+// index_to_code_token. Edges are sorted by token.
+struct DataFlowGraph {
+  std::vector<DataFlowToken> tokens;
+  // Variable names: the upper-cased tokens of a reference, space separated.
+  std::vector<std::string> variables;
+  std::vector<DataFlowEdge> edges;
+  std::vector<uint32_t> sources;
+};
+
+// Collects tokens and edges in a single walk over `root`. Statements are
+// taken in source order, as straight-line code: definitions made in one
+// branch of an IF replace those made before it. `code_page` is the encoding
+// of `source` when the tree was parsed from a CodePageInput, null for UTF-8;
+// token offsets are in `source` bytes either way.
+void extract_data_flow(const TSLanguage *language, const DataFlowRules &rules,
+                       TSNode root, const char *source,
+                       const CodePage *code_page, DataFlowGraph *graph);
+
+}  // namespace ts_native
+
+#endif  // TS_NATIVE_DATA_FLOW_H_
@@ -0,0 +1,196 @@
+#include "embedded_sql.h"
+
+#include <cctype>
+#include <cstring>
+#include <unordered_map>
+#include <utility>
+
+namespace ts_native {
+
+namespace {
+
+struct Definition {
+  uint32_t start_byte;
+  uint32_t end_byte;
+};
+
+class SqlReader {
+ public:
+  SqlReader(const char *source, const CodePage *code_page,
+            const std::unordered_map<std::string, Definition> &definitions,
+            EmbeddedSql *out)
+      : source_(source),
+        code_page_(code_page),
+        definitions_(definitions),
+        out_(out) {}
+
+  void Read(uint32_t start, uint32_t end, uint32_t row) {
+    uint32_t block = static_cast<uint32_t>(out_->blocks.size());
+    out_->blocks.push_back({start, end, row,
+                            static_cast<uint32_t>(out_->host_variables.size()),
+                            0});
+    std::string sql;
+
+    // The token is EXEC SQL on one line, the SQL, then END-EXEC.
+    uint32_t body_start = start + 4;
+    while (body_start < end && (character(body_start) == ' ' ||
+                                character(body_start) == '\t')) {
+      body_start++;
+    }
+    body_start += 3;
+    uint32_t body_end = end - 8;
+
+    // Columns are counted in bytes, as the scanner counts them, to leave
+    // the areas out the way it skips them.
+    uint32_t line_start = start;
+    while (line_start > 0 && character(line_start - 1) != '\n') line_start--;
+    uint32_t quote = 0;
+    uint32_t previous = ' ';
+    bool comment_line = false;
+    for (uint32_t i = start; i < body_end; i++) {
+      uint32_t c = character(i);
+      if (c == '\n') {
+        line_start = i + 1;
+        row++;
+        quote = 0;
+        comment_line = false;
+        if (i >= body_start) sql += '\n';
+        continue;
+      }
+      uint32_t column = i - line_start;
+      if (column == 6) comment_line = c == '*' || c == '/';
+      if (column <= 6 || column >= 72 || comment_line || i < body_start) {
+        continue;
+      }
+
+      if (quote != 0) {
+        if (c == quote) quote = 0;
+      } else if (c == '\'' || c == '"') {
+        quote = c;
+      } else if (c == ':' && previous != ':' && i + 1 < body_end &&
+                 is_name(character(i + 1))) {
+        AddHostVariable(block, i + 1, body_end, row);
+      }
+      previous = c;
+      append(i, &sql);
+    }
+
+    size_t first = sql.find_first_not_of(" \t\n");
+    size_t last = sql.find_last_not_of(" \t\n");
+    out_->sql.push_back(first == std::string::npos
+                            ? std::string()
+                            : sql.substr(first, last - first + 1));
+  }
+
+ private:
+  uint32_t character(uint32_t byte) const {
+    unsigned char c = source_[byte];
+    return code_page_ ? code_page_->to_unicode[c] : c;
+  }
+
+  static bool is_name(uint32_t c) {
+    return c < 0x80 && (isalnum(c) || c == '-' || c == '_');
+  }
+
+  void append(uint32_t byte, std::string *out) const {
+    if (code_page_) {
+      append_utf8(character(byte), out);
+    } else {
+      *out += source_[byte];
+    }
+  }
+
+  // Records the name starting at `start`, resolving its last qualifier.
+  void AddHostVariable(uint32_t block, uint32_t start, uint32_t limit,
+                       uint32_t row) {
+    uint32_t end = start;
+    uint32_t last = start;
+    while (end < limit) {
+      if (is_name(character(end))) {
+        end++;
+      } else if (character(end) == '.' && end + 1 < limit &&
+                 is_name(character(end + 1))) {
+        last = ++end;
+      } else {
+        break;
+      }
+    }
+    // COBOL names do not end in a hyphen.
+    while (end > last && character(end - 1) == '-') end--;
+
+    std::string name;
+    for (uint32_t i = last; i < end; i++) {
+      name += static_cast<char>(toupper(character(i)));
+    }
+    ts_native::HostVariable variable = {block, start, end, row, kNoDefinition,
+                                        kNoDefinition};
+    auto it = definitions_.find(name);
+    if (it != definitions_.end()) {
+      variable.definition_start = it->second.start_byte;
+      variable.definition_end = it->second.end_byte;
+    }
+    out_->host_variables.push_back(variable);
+    out_->blocks.back().host_variable_count++;
+  }
+
+  const char *source_;
+  const CodePage *code_page_;
+  const std::unordered_map<std::string, Definition> &definitions_;
+  EmbeddedSql *out_;
+};
+
+}  // namespace
+
+void extract_embedded_sql(const TSLanguage *language, TSNode root,
+                          const char *source, const CodePage *code_page,
+                          EmbeddedSql *out) {
+  TSSymbol exec_sql =
+      ts_language_symbol_for_name(language, "exec_sql", 8, true);
+  TSSymbol entry_name =
+      ts_language_symbol_for_name(language, "entry_name", 10, true);
+  if (exec_sql == 0) return;
+  uint32_t byte_shift = code_page ? CodePageInput::kByteShift : 0;
+
+  // Blocks are read once every data name is known: an exec_sql in the
+  // WORKING-STORAGE SECTION can come before the items it names.
+  std::vector<TSNode> blocks;
+  std::unordered_map<std::string, Definition> definitions;
+  TSTreeCursor cursor = ts_tree_cursor_new(root);
+  while (true) {
+    TSNode node = ts_tree_cursor_current_node(&cursor);
+    TSSymbol symbol = ts_node_symbol(node);
+    if (symbol == exec_sql) {
+      blocks.push_back(node);
+    } else if (symbol == entry_name && entry_name != 0) {
+      Definition definition = {ts_node_start_byte(node) >> byte_shift,
+                               ts_node_end_byte(node) >> byte_shift};
+      std::string name;
+      for (uint32_t i = definition.start_byte; i < definition.end_byte; i++) {
+        unsigned char c = source[i];
+        uint32_t u = code_page ? code_page->to_unicode[c] : c;
+        name += static_cast<char>(u < 0x80 ? toupper(u) : '?');
+      }
+      definitions.emplace(std::move(name), definition);
+    } else if (ts_tree_cursor_goto_first_child(&cursor)) {
+      continue;
+    }
+    bool done = false;
+    while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+      if (!ts_tree_cursor_goto_parent(&cursor)) {
+        done = true;
+        break;
+      }
+    }
+    if (done) break;
+  }
+  ts_tree_cursor_delete(&cursor);
+
+  SqlReader reader(source, code_page, definitions, out);
+  for (TSNode node : blocks) {
+    reader.Read(ts_node_start_byte(node) >> byte_shift,
+                ts_node_end_byte(node) >> byte_shift,
+                ts_node_start_point(node).row);
+  }
+}
+
+}  // namespace ts_native
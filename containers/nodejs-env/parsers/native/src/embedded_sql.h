@@ -0,0 +1,61 @@
+#ifndef TS_NATIVE_EMBEDDED_SQL_H_
+#define TS_NATIVE_EMBEDDED_SQL_H_
+
+#include <tree_sitter/api.h>
+
+#include "code_page.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ts_native {
+
+// One EXEC SQL ... END-EXEC block, which the grammar reads as a single
+// exec_sql token. Its host variables are the host_variable_count entries of
+// EmbeddedSql::host_variables from first_host_variable on.
+struct SqlBlock {
+  uint32_t start_byte;
+  uint32_t end_byte;
+  uint32_t row;
+  uint32_t first_host_variable;
+  uint32_t host_variable_count;
+};
+
+// definition_start of a host variable no data item is named after.
+const uint32_t kNoDefinition = UINT32_MAX;
+
+// A :NAME reference in a block. `start_byte`/`end_byte` delimit NAME,
+// without the colon, qualifiers (:GROUP.ITEM) included. `definition_start`/
+// `definition_end` delimit the entry_name of the data description it refers
+// to: the first one named like its last qualifier, ignoring case.
+struct HostVariable {
+  uint32_t block;
+  uint32_t start_byte;
+  uint32_t end_byte;
+  uint32_t row;
+  uint32_t definition_start;
+  uint32_t definition_end;
+};
+
+struct EmbeddedSql {
+  std::vector<SqlBlock> blocks;
+  // The SQL of each block, between EXEC SQL and END-EXEC, in UTF-8. The
+  // sequence, indicator and identification areas and the comment lines are
+  // left out, so that it can be handed to an SQL parser as is.
+  std::vector<std::string> sql;
+  std::vector<HostVariable> host_variables;
+};
+
+// Reads the exec_sql tokens of a tree in one walk, which also collects the
+// data names host variables are resolved against. Nothing is done unless
+// asked for, so parses that do not need the SQL pay nothing for it.
+// `code_page` is the encoding of `source` when the tree was parsed from a
+// CodePageInput, null for UTF-8; offsets are in `source` bytes either way.
+void extract_embedded_sql(const TSLanguage *language, TSNode root,
+                          const char *source, const CodePage *code_page,
+                          EmbeddedSql *out);
+
+}  // namespace ts_native
+
+#endif  // TS_NATIVE_EMBEDDED_SQL_H_
@@ -0,0 +1,148 @@
+#include "flat_tree.h"
+
+#include <vector>
+
+namespace ts_native {
+
+FlatTree FlatTree::Allocate(uint32_t node_count) {
+  using namespace flat_tree;
+
+  FlatTree tree;
+  size_t size = kHeaderSize + node_count * kBytesPerNode;
+  uint8_t *data = static_cast<uint8_t *>(malloc(size));
+  if (!data) return tree;
+  tree.data_.reset(data, FreeDeleter());
+  tree.size_ = size;
+  tree.node_count_ = node_count;
+
+  uint32_t *header = reinterpret_cast<uint32_t *>(tree.data_.get());
+  header[0] = kMagic;
+  header[1] = kVersion;
+  header[2] = node_count;
+  header[3] = 0;
+  return tree;
+}
+
+bool FlatTree::FromBlock(std::shared_ptr<uint8_t> data, size_t size,
+                         FlatTree *out) {
+  using namespace flat_tree;
+
+  if (size < kHeaderSize) return false;
+  const uint32_t *header = reinterpret_cast<const uint32_t *>(data.get());
+  if (header[0] != kMagic || header[1] != kVersion ||
+      size != kHeaderSize + static_cast<size_t>(header[2]) * kBytesPerNode) {
+    return false;
+  }
+  out->data_ = std::move(data);
+  out->size_ = size;
+  out->node_count_ = header[2];
+  return true;
+}
+
+FlatTree FlatTree::FromNode(TSNode root, uint32_t byte_shift) {
+  using namespace flat_tree;
+
+  FlatTree tree = Allocate(ts_node_descendant_count(root));
+  if (!tree.data()) return tree;
+
+  uint32_t *start_byte = tree.start_bytes();
+  uint32_t *end_byte = tree.end_bytes();
+  uint32_t *start_row = tree.start_rows();
+  uint32_t *start_column = tree.start_columns();
+  uint32_t *end_row = tree.end_rows();
+  uint32_t *end_column = tree.end_columns();
+  int32_t *parent = tree.parents();
+  uint16_t *symbol = tree.symbols();
+  uint16_t *field = tree.fields();
+  uint8_t *flags = tree.flags();
+
+  // Index of the node at each depth of the current cursor path.
+  std::vector<int32_t> ancestors;
+  TSTreeCursor cursor = ts_tree_cursor_new(root);
+  uint32_t i = 0;
+  for (;;) {
+    TSNode node = ts_tree_cursor_current_node(&cursor);
+    TSPoint start = ts_node_start_point(node);
+    TSPoint end = ts_node_end_point(node);
+
+    start_byte[i] = ts_node_start_byte(node) >> byte_shift;
+    end_byte[i] = ts_node_end_byte(node) >> byte_shift;
+    start_row[i] = start.row;
+    start_column[i] = start.column >> byte_shift;
+    end_row[i] = end.row;
+    end_column[i] = end.column >> byte_shift;
+    parent[i] = ancestors.empty() ? -1 : ancestors.back();
+    symbol[i] = ts_node_symbol(node);
+    field[i] = ts_tree_cursor_current_field_id(&cursor);
+    flags[i] = (ts_node_is_named(node) ? kFlagNamed : 0) |
+               (ts_node_is_missing(node) ? kFlagMissing : 0) |
+               (ts_node_is_extra(node) ? kFlagExtra : 0) |
+               (ts_node_has_error(node) ? kFlagHasError : 0);
+
+    if (ts_tree_cursor_goto_first_child(&cursor)) {
+      ancestors.push_back(i++);
+      continue;
+    }
+    i++;
+    while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+      if (!ts_tree_cursor_goto_parent(&cursor)) {
+        ts_tree_cursor_delete(&cursor);
+        return tree;
+      }
+      ancestors.pop_back();
+    }
+  }
+}
+
+FlatTree FlatTree::Join(const std::vector<FlatTree> &parts,
+                        const std::vector<uint32_t> &byte_offsets,
+                        const std::vector<uint32_t> &row_offsets) {
+  using namespace flat_tree;
+
+  uint32_t n = 1;
+  for (const FlatTree &part : parts) n += part.node_count() - 1;
+  FlatTree tree = Allocate(n);
+  if (!tree.data()) return tree;
+  const FlatTree &first = parts.front();
+  const FlatTree &last = parts.back();
+
+  // The root spans the whole document.
+  tree.start_bytes()[0] = 0;
+  tree.start_rows()[0] = 0;
+  tree.start_columns()[0] = 0;
+  tree.end_bytes()[0] = last.end_bytes()[0] + byte_offsets.back();
+  tree.end_rows()[0] = last.end_rows()[0] + row_offsets.back();
+  tree.end_columns()[0] = last.end_columns()[0];
+  tree.parents()[0] = -1;
+  tree.symbols()[0] = first.symbols()[0];
+  tree.fields()[0] = 0;
+  tree.flags()[0] = first.flags()[0];
+
+  // Every part's nodes but its root, in order, keep their pre-order.
+  uint32_t base = 1;
+  for (size_t p = 0; p < parts.size(); p++) {
+    const FlatTree &part = parts[p];
+    uint32_t byte_offset = byte_offsets[p];
+    uint32_t row_offset = row_offsets[p];
+    tree.flags()[0] |= part.flags()[0] & kFlagHasError;
+    for (uint32_t j = 1; j < part.node_count(); j++) {
+      uint32_t i = base + j - 1;
+      tree.start_bytes()[i] = part.start_bytes()[j] + byte_offset;
+      tree.end_bytes()[i] = part.end_bytes()[j] + byte_offset;
+      tree.start_rows()[i] = part.start_rows()[j] + row_offset;
+      tree.start_columns()[i] = part.start_columns()[j];
+      tree.end_rows()[i] = part.end_rows()[j] + row_offset;
+      tree.end_columns()[i] = part.end_columns()[j];
+      int32_t parent = part.parents()[j];
+      tree.parents()[i] =
+          parent == 0 ? 0 : static_cast<int32_t>(base) + parent - 1;
+      tree.symbols()[i] = part.symbols()[j];
+      tree.fields()[i] = part.fields()[j];
+      tree.flags()[i] = part.flags()[j];
+    }
+    base += part.node_count() - 1;
+  }
+  return tree;
+}
+
+}  // namespace ts_native
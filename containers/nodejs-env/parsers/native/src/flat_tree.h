@@ -0,0 +1,112 @@
+#ifndef TS_NATIVE_FLAT_TREE_H_
+#define TS_NATIVE_FLAT_TREE_H_
+
+#include <tree_sitter/api.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+namespace ts_native {
+
+// A syntax tree flattened into one block of struct-of-arrays columns, indexed
+// by the node's position in a pre-order walk (the root is node 0). The block
+// is malloc'd, or mapped from a parse cache entry (parse_cache.h).
+//
+//   header   uint32[4]  magic "TSFL", version, node count, reserved
+//   uint32   start_byte, end_byte, start_row, start_column,
+//            end_row, end_column
+//   int32    parent          (-1 for the root)
+//   uint16   symbol, field   (field 0 means "no field")
+//   uint8    flags           (kFlag* below)
+//
+// Columns are laid out back to back in that order, each `node_count` long,
+// so every column is naturally aligned and can be wrapped by a typed array
+// view without copying. native/bindings/node/index.js mirrors this layout.
+namespace flat_tree {
+
+constexpr uint32_t kMagic = 0x4c465354;  // "TSFL" read as little-endian
+constexpr uint32_t kVersion = 1;
+constexpr size_t kHeaderSize = 4 * sizeof(uint32_t);
+constexpr size_t kBytesPerNode =
+    6 * sizeof(uint32_t) + sizeof(int32_t) + 2 * sizeof(uint16_t) + 1;
+
+constexpr uint8_t kFlagNamed = 1 << 0;
+constexpr uint8_t kFlagMissing = 1 << 1;
+constexpr uint8_t kFlagExtra = 1 << 2;
+constexpr uint8_t kFlagHasError = 1 << 3;
+
+}  // namespace flat_tree
+
+class FlatTree {
+ public:
+  FlatTree() : size_(0), node_count_(0) {}
+
+  // Builds the columns in a single cursor walk over `root`. Byte offsets and
+  // columns are shifted right by `byte_shift`, for trees parsed from a
+  // CodePageInput (code_page.h). Like Join, returns an empty tree, with a
+  // null data(), when the block cannot be allocated.
+  static FlatTree FromNode(TSNode root, uint32_t byte_shift = 0);
+
+  // Joins the trees of consecutive slices of one document, each parsed on
+  // its own, into one tree under the first tree's root; the other roots are
+  // dropped and their children adopted. Part i starts at byte_offsets[i]
+  // and row_offsets[i] of the document, always at a line start, so columns
+  // stay as they are.
+  static FlatTree Join(const std::vector<FlatTree> &parts,
+                       const std::vector<uint32_t> &byte_offsets,
+                       const std::vector<uint32_t> &row_offsets);
+
+  // Adopts a block laid out as above, e.g. inside a mapped file, after
+  // checking its header against `size`. Returns false for anything else.
+  static bool FromBlock(std::shared_ptr<uint8_t> data, size_t size,
+                        FlatTree *out);
+
+  uint8_t *data() const { return data_.get(); }
+  size_t size() const { return size_; }
+  uint32_t node_count() const { return node_count_; }
+
+  // Column accessors, in layout order.
+  uint32_t *start_bytes() const {
+    return reinterpret_cast<uint32_t *>(data_.get() + flat_tree::kHeaderSize);
+  }
+  uint32_t *end_bytes() const { return start_bytes() + node_count_; }
+  uint32_t *start_rows() const { return end_bytes() + node_count_; }
+  uint32_t *start_columns() const { return start_rows() + node_count_; }
+  uint32_t *end_rows() const { return start_columns() + node_count_; }
+  uint32_t *end_columns() const { return end_rows() + node_count_; }
+  int32_t *parents() const {
+    return reinterpret_cast<int32_t *>(end_columns() + node_count_);
+  }
+  uint16_t *symbols() const {
+    return reinterpret_cast<uint16_t *>(parents() + node_count_);
+  }
+  uint16_t *fields() const { return symbols() + node_count_; }
+  uint8_t *flags() const {
+    return reinterpret_cast<uint8_t *>(fields() + node_count_);
+  }
+
+  // Hands the block over to the caller; it lives as long as the pointer.
+  std::shared_ptr<uint8_t> release() {
+    size_ = 0;
+    node_count_ = 0;
+    return std::move(data_);
+  }
+
+ private:
+  static FlatTree Allocate(uint32_t node_count);
+
+  struct FreeDeleter {
+    void operator()(uint8_t *data) const { free(data); }
+  };
+
+  std::shared_ptr<uint8_t> data_;
+  size_t size_;
+  uint32_t node_count_;
+};
+
+}  // namespace ts_native
+
+#endif  // TS_NATIVE_FLAT_TREE_H_
@@ -0,0 +1,52 @@
+#ifndef TS_NATIVE_GRAMMAR_H_
+#define TS_NATIVE_GRAMMAR_H_
+
+#include <tree_sitter/api.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace ts_native {
+
+struct CodePage;
+struct DataFlowRules;
+struct Landmark;
+
+// A language plus the grammar-specific native entry points its binding
+// provides. Each addon defines exactly one, statically, in its binding.cc.
+struct Grammar {
+  const char *name;
+  const TSLanguage *language;
+
+  // Tells the external scanner, for the calling thread, that the parse only
+  // sees the source area of a fixed-format program (see source_areas.h).
+  // parse_source switches it on and off around each parse; other parses
+  // through the ranges of scan_fixed_format have to do the same. Null for
+  // grammars without a fixed format.
+  void (*set_source_areas_stripped)(bool stripped);
+
+  // Whether COPY statements can be expanded before parsing (copybook.h).
+  bool copy_statements;
+
+  // Statements and operands the data flow extractor follows (data_flow.h).
+  // Null for grammars it does not support.
+  const DataFlowRules *data_flow;
+
+  // Whether a document can hold several programs that parse on their own,
+  // and so be split at their headers (program_split.h).
+  bool split_programs;
+
+  // Lists the landmarks of a document without parsing it (skeleton.h).
+  // Null for grammars without a skeleton extractor.
+  void (*extract_skeleton)(const char *text, uint32_t length,
+                           const CodePage *code_page,
+                           std::vector<Landmark> *landmarks);
+
+  // Whether EXEC SQL blocks are exec_sql tokens whose SQL and host variables
+  // can be read (embedded_sql.h).
+  bool embedded_sql;
+};
+
+}  // namespace ts_native
+
+#endif  // TS_NATIVE_GRAMMAR_H_
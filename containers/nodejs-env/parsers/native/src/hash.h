@@ -0,0 +1,33 @@
+#ifndef TS_NATIVE_HASH_H_
+#define TS_NATIVE_HASH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace ts_native {
+
+const uint64_t kFnvOffsetBasis = 0xcbf29ce484222325ull;
+
+// 64-bit FNV-1a, chained through `seed` to hash several pieces as one.
+inline uint64_t fnv1a(const void *data, size_t length,
+                      uint64_t seed = kFnvOffsetBasis) {
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+  uint64_t hash = seed;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+inline uint64_t fnv1a(const std::string &text,
+                      uint64_t seed = kFnvOffsetBasis) {
+  // Hash the length too, so ("ab", "c") and ("a", "bc") differ when chained.
+  uint64_t length = text.size();
+  return fnv1a(text.data(), text.size(), fnv1a(&length, sizeof(length), seed));
+}
+
+}  // namespace ts_native
+
+#endif  // TS_NATIVE_HASH_H_
@@ -0,0 +1,56 @@
+#include "languages.h"
+
+#include <cctype>
+
+// languages.inc is generated by CMakeLists.txt, one
+// TS_LANGUAGE("name", tree_sitter_name) line per grammar.
+
+extern "C" {
+#define TS_LANGUAGE(name, function) const TSLanguage *function(void);
+#include "languages.inc"
+#undef TS_LANGUAGE
+}
+
+namespace {
+
+struct Entry {
+  const char *name;
+  const TSLanguage *(*language)(void);
+};
+
+// A table of function pointers rather than TSLanguage pointers, so nothing
+// in a grammar's data is touched until it is asked for.
+const Entry kLanguages[] = {
+#define TS_LANGUAGE(name, function) {name, function},
+#include "languages.inc"
+#undef TS_LANGUAGE
+    {nullptr, nullptr},
+};
+
+const size_t kLanguageCount = sizeof(kLanguages) / sizeof(kLanguages[0]) - 1;
+
+bool same_name(const char *a, const char *b) {
+  for (; *a && *b; a++, b++) {
+    if (tolower(static_cast<unsigned char>(*a)) !=
+        tolower(static_cast<unsigned char>(*b))) {
+      return false;
+    }
+  }
+  return *a == *b;
+}
+
+}  // namespace
+
+const TSLanguage *ts_languages_get(const char *name) {
+  if (!name) return nullptr;
+  for (size_t i = 0; i < kLanguageCount; i++) {
+    if (same_name(kLanguages[i].name, name)) return kLanguages[i].language();
+  }
+  return nullptr;
+}
+
+size_t ts_languages_count(void) { return kLanguageCount; }
+
+const char *ts_languages_name(size_t index) {
+  return index < kLanguageCount ? kLanguages[index].name : nullptr;
+}
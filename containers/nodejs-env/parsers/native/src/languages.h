@@ -0,0 +1,40 @@
+#ifndef TS_NATIVE_LANGUAGES_H_
+#define TS_NATIVE_LANGUAGES_H_
+
+// C API of my-languages.so, the shared library CMakeLists.txt builds from
+// every grammar checked out next to it.
+//
+// Languages are looked up by the name in their grammar.json ("COBOL",
+// "coolgen", "c_sharp", ...), ignoring case. The library has no static
+// initializers: a grammar's parse tables are only paged in once a parser
+// actually uses them, so a process pays for the grammars it looks up and not
+// for the ones it merely links. The tree_sitter_<name>() entry points stay
+// exported for loaders that look them up themselves.
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct TSLanguage TSLanguage;
+
+#if defined(_WIN32)
+#define TS_LANGUAGES_API __declspec(dllexport)
+#else
+#define TS_LANGUAGES_API __attribute__((visibility("default")))
+#endif
+
+// Returns NULL for a language the library was not built with.
+TS_LANGUAGES_API const TSLanguage *ts_languages_get(const char *name);
+
+TS_LANGUAGES_API size_t ts_languages_count(void);
+
+// Name of the index-th language, in build order; NULL past the end.
+TS_LANGUAGES_API const char *ts_languages_name(size_t index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // TS_NATIVE_LANGUAGES_H_
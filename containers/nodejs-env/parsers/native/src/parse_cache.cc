@@ -0,0 +1,280 @@
+#include "parse_cache.h"
+
+#include "batch_parse.h"
+#include "hash.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#if defined(_WIN32)
+#include <direct.h>
+#include <io.h>
+#include <process.h>
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace ts_native {
+
+namespace {
+
+const uint32_t kMagic = 0x43505354;  // "TSPC" read as little-endian
+// Bumped whenever the entry layout or what goes into it changes.
+const uint32_t kVersion = 1;
+
+// An entry is this header, comment_count CommentLines and the flat tree.
+struct EntryHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t fingerprint;
+  uint64_t options;
+  // A second hash of the source, with another seed than the file name's,
+  // so that a collision of one does not serve the wrong tree.
+  uint64_t source_check;
+  uint32_t source_length;
+  uint32_t node_count;
+  uint32_t error_count;
+  uint32_t missing_count;
+  uint32_t comment_count;
+  uint32_t flat_size;
+  uint32_t reserved[2];
+};
+
+static_assert(sizeof(EntryHeader) == 64, "EntryHeader is read as 64 bytes");
+static_assert(sizeof(CommentLine) == 16, "CommentLine is stored as 16 bytes");
+
+const uint64_t kCheckSeed = kFnvOffsetBasis ^ 0x9e3779b97f4a7c15ull;
+
+std::string hex(uint64_t value) {
+  char text[17];
+  snprintf(text, sizeof(text), "%016llx",
+           static_cast<unsigned long long>(value));
+  return text;
+}
+
+// The options an entry depends on.
+uint64_t options_hash(const ParseOptions &options) {
+  uint64_t hash = fnv1a(std::string(options.fixed_format ? "fixed" : "free"));
+  return fnv1a(std::string(options.code_page ? options.code_page->name : ""),
+               hash);
+}
+
+bool make_directories(const std::string &path) {
+  for (size_t i = 1; i <= path.size(); i++) {
+    if (i < path.size() && path[i] != '/' && path[i] != '\\') continue;
+    std::string prefix = path.substr(0, i);
+#if defined(_WIN32)
+    int status = _mkdir(prefix.c_str());
+#else
+    int status = mkdir(prefix.c_str(), 0777);
+#endif
+    if (status != 0 && errno != EEXIST) return false;
+  }
+  return true;
+}
+
+// The path of the executable or shared library `address` belongs to.
+std::string module_path(const void *address) {
+#if defined(_WIN32)
+  HMODULE module;
+  char path[MAX_PATH];
+  if (!GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS |
+                              GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                          static_cast<LPCSTR>(address), &module) ||
+      GetModuleFileNameA(module, path, sizeof(path)) == 0) {
+    return "";
+  }
+  return path;
+#else
+  Dl_info info;
+  if (!dladdr(address, &info) || !info.dli_fname) return "";
+  return info.dli_fname;
+#endif
+}
+
+// The grammar's fingerprint. Without the bytes of its binary, a rebuilt
+// scanner or regenerated parser could keep the counts and be served entries
+// parsed by the old one, so failing to read them is an error.
+bool language_fingerprint(const TSLanguage *language, uint64_t *fingerprint,
+                          std::string *error) {
+  uint32_t counts[] = {
+      kVersion,
+      ts_language_version(language),
+      ts_language_symbol_count(language),
+      ts_language_state_count(language),
+      ts_language_field_count(language),
+  };
+  // The parse tables and the external scanner are in the binary the
+  // language is compiled into, so its bytes change whenever either does.
+  std::string path = module_path(language);
+  if (path.empty()) {
+    *error = "cannot find the binary the language is compiled into";
+    return false;
+  }
+  std::string binary;
+  if (!read_file(path, &binary, error)) return false;
+  *fingerprint = fnv1a(binary, fnv1a(counts, sizeof(counts)));
+  return true;
+}
+
+// The contents of `path`, mapped copy-on-write so that JS may write to the
+// flat tree buffer. `owner` unmaps it.
+bool map_file(const std::string &path, std::shared_ptr<uint8_t> *owner,
+              size_t *size) {
+#if defined(_WIN32)
+  std::string contents, error;
+  if (!read_file(path, &contents, &error)) return false;
+  *size = contents.size();
+  uint8_t *data = static_cast<uint8_t *>(malloc(*size ? *size : 1));
+  memcpy(data, contents.data(), *size);
+  owner->reset(data, [](uint8_t *data) { free(data); });
+  return true;
+#else
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    return false;
+  }
+  size_t length = static_cast<size_t>(st.st_size);
+  void *data = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) return false;
+  *size = length;
+  owner->reset(static_cast<uint8_t *>(data),
+               [length](uint8_t *data) { munmap(data, length); });
+  return true;
+#endif
+}
+
+}  // namespace
+
+const ParseCache *ParseCache::Get(const std::string &directory,
+                                  const TSLanguage *language,
+                                  std::string *error) {
+  static std::mutex *mutex = new std::mutex();
+  static auto *caches =
+      new std::map<std::pair<const TSLanguage *, std::string>, ParseCache *>();
+  std::lock_guard<std::mutex> lock(*mutex);
+  auto it = caches->find({language, directory});
+  if (it != caches->end()) return it->second;
+
+  uint64_t fingerprint;
+  if (!language_fingerprint(language, &fingerprint, error)) {
+    *error = "cannot fingerprint the grammar: " + *error;
+    return nullptr;
+  }
+  std::string path = directory + "/" + hex(fingerprint);
+  if (!make_directories(path)) {
+    *error = "cannot create " + path + ": " + strerror(errno);
+    return nullptr;
+  }
+  return (*caches)[{language, directory}] = new ParseCache(path, fingerprint);
+}
+
+bool ParseCache::Covers(const ParseOptions &options) {
+  return !options.include_sexp && !options.data_flow && !options.query &&
+         !options.embedded_sql;
+}
+
+std::string ParseCache::EntryPath(const char *source, uint32_t length,
+                                  const ParseOptions &options) const {
+  return directory_ + "/" +
+         hex(fnv1a(source, length, options_hash(options))) + ".tsc";
+}
+
+bool ParseCache::Load(const char *source, uint32_t length,
+                      const ParseOptions &options, ParseResult *result) const {
+  std::shared_ptr<uint8_t> entry;
+  size_t size;
+  if (!map_file(EntryPath(source, length, options), &entry, &size)) {
+    return false;
+  }
+  if (size < sizeof(EntryHeader)) return false;
+  EntryHeader header;
+  memcpy(&header, entry.get(), sizeof(header));
+  size_t comments_size = header.comment_count * sizeof(CommentLine);
+  if (header.magic != kMagic || header.version != kVersion ||
+      header.fingerprint != fingerprint_ ||
+      header.options != options_hash(options) ||
+      header.source_length != length ||
+      size != sizeof(header) + comments_size + header.flat_size ||
+      header.source_check != fnv1a(source, length, kCheckSeed)) {
+    return false;
+  }
+
+  const uint8_t *comments = entry.get() + sizeof(header);
+  FlatTree flat;
+  if (options.include_flat &&
+      !FlatTree::FromBlock(
+          std::shared_ptr<uint8_t>(entry, entry.get() + sizeof(header) +
+                                              comments_size),
+          header.flat_size, &flat)) {
+    return false;
+  }
+  result->node_count = header.node_count;
+  result->error_count = header.error_count;
+  result->missing_count = header.missing_count;
+  result->comment_lines.resize(header.comment_count);
+  if (comments_size) {
+    memcpy(result->comment_lines.data(), comments, comments_size);
+  }
+  result->flat = std::move(flat);
+  return true;
+}
+
+void ParseCache::Store(const char *source, uint32_t length,
+                       const ParseOptions &options,
+                       const ParseResult &result) const {
+  EntryHeader header = {};
+  header.magic = kMagic;
+  header.version = kVersion;
+  header.fingerprint = fingerprint_;
+  header.options = options_hash(options);
+  header.source_check = fnv1a(source, length, kCheckSeed);
+  header.source_length = length;
+  header.node_count = result.node_count;
+  header.error_count = result.error_count;
+  header.missing_count = result.missing_count;
+  header.comment_count = static_cast<uint32_t>(result.comment_lines.size());
+  header.flat_size = static_cast<uint32_t>(result.flat.size());
+
+  std::string path = EntryPath(source, length, options);
+#if defined(_WIN32)
+  int pid = _getpid();
+#else
+  int pid = getpid();
+#endif
+  std::string temporary =
+      path + ".tmp" + std::to_string(pid) + "-" +
+      std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+  FILE *file = fopen(temporary.c_str(), "wb");
+  if (!file) return;
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+  if (ok && header.comment_count) {
+    ok = fwrite(result.comment_lines.data(), sizeof(CommentLine),
+                header.comment_count, file) == header.comment_count;
+  }
+  if (ok && header.flat_size) {
+    ok = fwrite(result.flat.data(), header.flat_size, 1, file) == 1;
+  }
+  ok = fclose(file) == 0 && ok;
+  if (!ok || rename(temporary.c_str(), path.c_str()) != 0) {
+    remove(temporary.c_str());
+  }
+}
+
+}  // namespace ts_native
@@ -0,0 +1,73 @@
+#ifndef TS_NATIVE_PARSE_CACHE_H_
+#define TS_NATIVE_PARSE_CACHE_H_
+
+#include <tree_sitter/api.h>
+
+#include <cstdint>
+#include <string>
+#include <utility>
+
+namespace ts_native {
+
+struct ParseOptions;
+struct ParseResult;
+
+// An on-disk cache of parse results, so that files which have not changed
+// since the last run are not parsed again. An entry holds what a parse
+// without a live tree yields: the counts, the comment lines and the flat
+// tree (flat_tree.h). It is found by the hash of the source and of the
+// options that change the tree (fixed format, code page), and loaded with
+// mmap: the flat tree handed to JS is the mapped entry itself.
+//
+// Entries live under a directory named after the grammar's fingerprint,
+// made of the language ABI version, its symbol, state and field counts, and
+// a hash of the binary the language is compiled into. Generating the parser
+// again and rebuilding therefore starts a new directory, and so does any
+// change to the external scanner, with no manual invalidation. Old
+// directories can be deleted at will.
+//
+// Entries are written to a temporary file and renamed into place, so
+// concurrent runs sharing a directory only ever see whole entries, and a
+// mapped entry stays valid when another run replaces it.
+class ParseCache {
+ public:
+  // Opens the cache of `language` under `directory`, creating both as
+  // needed, or returns the one opened before. Caches are kept for the life
+  // of the process. Returns null and sets `error` when the binary the
+  // language is compiled into cannot be read for its fingerprint, or the
+  // directory cannot be created.
+  static const ParseCache *Get(const std::string &directory,
+                               const TSLanguage *language, std::string *error);
+
+  uint64_t fingerprint() const { return fingerprint_; }
+  const std::string &directory() const { return directory_; }
+
+  // Whether a parse with `options` can be served from and stored in the
+  // cache: not when it needs the live tree, for an S-expression, data flow,
+  // a query or embedded SQL.
+  static bool Covers(const ParseOptions &options);
+
+  // Fills in the counts, comment lines and flat tree of `result` from the
+  // entry for `source`, if there is one.
+  bool Load(const char *source, uint32_t length, const ParseOptions &options,
+            ParseResult *result) const;
+
+  // Writes the entry for `source` from a parse that built a flat tree.
+  // Failures are ignored: the next run parses the file again.
+  void Store(const char *source, uint32_t length, const ParseOptions &options,
+             const ParseResult &result) const;
+
+ private:
+  ParseCache(std::string directory, uint64_t fingerprint)
+      : directory_(std::move(directory)), fingerprint_(fingerprint) {}
+
+  std::string EntryPath(const char *source, uint32_t length,
+                        const ParseOptions &options) const;
+
+  std::string directory_;
+  uint64_t fingerprint_;
+};
+
+}  // namespace ts_native
+
+#endif  // TS_NATIVE_PARSE_CACHE_H_
@@ -0,0 +1,132 @@
+#include "program_split.h"
+
+namespace ts_native {
+
+namespace {
+
+const uint32_t kIndicatorColumn = 6;
+const uint32_t kAreaAStart = 7;
+const uint32_t kAreaBEnd = 72;
+
+// The characters of a line, or of its area A/B, decoded.
+class Line {
+ public:
+  Line(const char *begin, uint32_t length, const CodePage *code_page)
+      : begin_(begin), length_(length), code_page_(code_page) {}
+
+  uint32_t length() const { return length_; }
+  uint32_t operator[](uint32_t i) const {
+    unsigned char byte = begin_[i];
+    return code_page_ ? code_page_->to_unicode[byte] : byte;
+  }
+
+  // Matches `word` (upper case) at `*i` in any case and moves past it.
+  bool word(uint32_t *i, const char *word) const {
+    uint32_t j = *i;
+    for (; *word; word++, j++) {
+      if (j >= length_) return false;
+      uint32_t c = (*this)[j];
+      if (c >= 'a' && c <= 'z') c -= 'a' - 'A';
+      if (c != static_cast<unsigned char>(*word)) return false;
+    }
+    *i = j;
+    return true;
+  }
+
+  bool blank(uint32_t i) const {
+    uint32_t c = (*this)[i];
+    return c == ' ' || c == '\t';
+  }
+
+ private:
+  const char *begin_;
+  uint32_t length_;
+  const CodePage *code_page_;
+};
+
+enum class Boundary { kNone, kHeader, kEnd };
+
+// Whether `line` begins with IDENTIFICATION DIVISION or END PROGRAM.
+Boundary find_boundary(const Line &line) {
+  uint32_t i = 0;
+  while (i < line.length() && line.blank(i)) i++;
+  const char *second;
+  Boundary boundary;
+  if (line.word(&i, "IDENTIFICATION")) {
+    second = "DIVISION";
+    boundary = Boundary::kHeader;
+  } else if (line.word(&i, "END")) {
+    second = "PROGRAM";
+    boundary = Boundary::kEnd;
+  } else {
+    return Boundary::kNone;
+  }
+  uint32_t gap = i;
+  while (i < line.length() && line.blank(i)) i++;
+  if (i == gap || !line.word(&i, second)) return Boundary::kNone;
+  if (i == line.length()) return boundary;
+  uint32_t c = line[i];
+  // END PROGRAM is always followed by the program name.
+  if (boundary == Boundary::kHeader && c == '.') return boundary;
+  return c == ' ' || c == '\t' || c == '\r' ? boundary : Boundary::kNone;
+}
+
+}  // namespace
+
+void find_programs(const char *text, uint32_t length, const CodePage *code_page,
+                   bool fixed_format, std::vector<ProgramSpan> *programs) {
+  programs->clear();
+  uint32_t row = 0;
+  uint32_t line_start = 0;
+  // Where the line after the last END PROGRAM since the last header starts,
+  // if there was one.
+  bool ended = false;
+  uint32_t ended_byte = 0;
+  uint32_t ended_row = 0;
+  while (line_start < length) {
+    const char *newline =
+        find_line_end(text + line_start, text + length, code_page);
+    uint32_t line_end = newline ? newline - text : length;
+    uint32_t line_length = line_end - line_start;
+    uint32_t next = newline ? line_end + 1 : length;
+
+    Boundary boundary = Boundary::kNone;
+    if (line_length > kAreaAStart) {
+      unsigned char byte = text[line_start + kIndicatorColumn];
+      uint32_t indicator = code_page ? code_page->to_unicode[byte] : byte;
+      uint32_t area_length =
+          (line_length < kAreaBEnd ? line_length : kAreaBEnd) - kAreaAStart;
+      if (indicator != '*' && indicator != '/') {
+        boundary = find_boundary(
+            Line(text + line_start + kAreaAStart, area_length, code_page));
+      }
+    }
+    if (boundary == Boundary::kNone && !fixed_format) {
+      boundary = find_boundary(Line(text + line_start, line_length, code_page));
+    }
+
+    if (boundary == Boundary::kHeader) {
+      if (programs->empty()) {
+        // Anything before the first header belongs to the first program.
+        programs->push_back({0, 0, 0});
+      } else {
+        uint32_t start = ended ? ended_byte : line_start;
+        programs->back().end_byte = start;
+        programs->push_back({start, 0, ended ? ended_row : row});
+      }
+      ended = false;
+    } else if (boundary == Boundary::kEnd && !programs->empty()) {
+      ended = true;
+      ended_byte = next;
+      ended_row = row + 1;
+    }
+
+    line_start = next;
+    row++;
+  }
+
+  if (programs->empty()) programs->push_back({0, 0, 0});
+  programs->back().end_byte = length;
+}
+
+}  // namespace ts_native
@@ -0,0 +1,41 @@
+#ifndef TS_NATIVE_PROGRAM_SPLIT_H_
+#define TS_NATIVE_PROGRAM_SPLIT_H_
+
+#include "code_page.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace ts_native {
+
+// One program of a COBOL document: from the line after the previous
+// program's last END PROGRAM, or else from the line of its own
+// IDENTIFICATION DIVISION header, up to where the next program starts. The
+// first program also takes whatever precedes its header, and the last one
+// whatever follows it.
+struct ProgramSpan {
+  uint32_t start_byte;
+  uint32_t end_byte;
+  uint32_t start_row;
+};
+
+// Finds the programs of a COBOL document in one pass over its lines. A
+// program starts at every line that begins with IDENTIFICATION DIVISION, in
+// any case, outside comment lines. This is where the grammar starts a new
+// program_definition too: it has no nested programs, so every header begins
+// a top-level one. When END PROGRAM lines come between two headers, the
+// split is made after the last of them, which the grammar puts in the
+// earlier program. Spans start at line starts, so a tree parsed from one
+// keeps its columns and only its byte offsets and rows move. A document
+// without a header is one span.
+//
+// With `fixed_format` the lines are read as the stripped parse sees them:
+// only area A/B (columns 8-72) counts. Otherwise the scanner reads whole
+// lines, fixed-format or free-format ones, so a line counts as well when it
+// begins with the words from its first column.
+void find_programs(const char *text, uint32_t length, const CodePage *code_page,
+                   bool fixed_format, std::vector<ProgramSpan> *programs);
+
+}  // namespace ts_native
+
+#endif  // TS_NATIVE_PROGRAM_SPLIT_H_
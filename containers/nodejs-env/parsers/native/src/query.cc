@@ -0,0 +1,273 @@
+#include "query.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace ts_native {
+
+namespace {
+
+const char *const kQueryErrors[] = {
+    "none", "syntax error", "invalid node type", "invalid field",
+    "invalid capture", "impossible pattern", "language mismatch",
+};
+
+const uint32_t kNoCapture = UINT32_MAX;
+
+struct CursorDeleter {
+  void operator()(TSQueryCursor *cursor) const {
+    ts_query_cursor_delete(cursor);
+  }
+};
+
+void node_text(TSNode node, const char *source, const CodePage *code_page,
+               uint32_t byte_shift, std::string *out) {
+  uint32_t start = ts_node_start_byte(node) >> byte_shift;
+  uint32_t end = ts_node_end_byte(node) >> byte_shift;
+  out->clear();
+  if (!code_page) {
+    out->assign(source + start, end - start);
+    return;
+  }
+  for (uint32_t i = start; i < end; i++) {
+    append_utf8(code_page->to_unicode[static_cast<unsigned char>(source[i])],
+                out);
+  }
+}
+
+bool starts_with(const std::string &text, const char *prefix) {
+  return text.compare(0, strlen(prefix), prefix) == 0;
+}
+
+}  // namespace
+
+const Query *Query::Get(const TSLanguage *language, const std::string &source,
+                        std::string *error) {
+  static std::mutex *mutex = new std::mutex();
+  static auto *cache =
+      new std::map<std::pair<const TSLanguage *, std::string>, Query *>();
+  std::lock_guard<std::mutex> lock(*mutex);
+  auto it = cache->find({language, source});
+  if (it != cache->end()) return it->second;
+
+  uint32_t error_offset = 0;
+  TSQueryError error_type = TSQueryErrorNone;
+  TSQuery *ts_query =
+      ts_query_new(language, source.data(), static_cast<uint32_t>(source.size()),
+                   &error_offset, &error_type);
+  if (!ts_query) {
+    size_t type = static_cast<size_t>(error_type);
+    *error = std::string("Query ") +
+             (type < sizeof(kQueryErrors) / sizeof(kQueryErrors[0])
+                  ? kQueryErrors[type]
+                  : "error") +
+             " at offset " + std::to_string(error_offset);
+    return nullptr;
+  }
+  std::unique_ptr<Query> query(new Query(ts_query));
+  if (!query->ParsePredicates(error)) {
+    ts_query_delete(ts_query);
+    return nullptr;
+  }
+  return (*cache)[{language, source}] = query.release();
+}
+
+uint32_t Query::pattern_count() const { return ts_query_pattern_count(query_); }
+
+std::vector<std::string> Query::capture_names() const {
+  std::vector<std::string> names(ts_query_capture_count(query_));
+  for (uint32_t i = 0; i < names.size(); i++) {
+    uint32_t length;
+    const char *name = ts_query_capture_name_for_id(query_, i, &length);
+    names[i].assign(name, length);
+  }
+  return names;
+}
+
+bool Query::ParsePredicates(std::string *error) {
+  uint32_t pattern_count = ts_query_pattern_count(query_);
+  predicates_.resize(pattern_count);
+  for (uint32_t pattern = 0; pattern < pattern_count; pattern++) {
+    uint32_t step_count;
+    const TSQueryPredicateStep *steps =
+        ts_query_predicates_for_pattern(query_, pattern, &step_count);
+
+    // Each predicate is a name, its arguments and a Done step.
+    for (uint32_t i = 0; i < step_count;) {
+      uint32_t end = i;
+      while (end < step_count &&
+             steps[end].type != TSQueryPredicateStepTypeDone) {
+        end++;
+      }
+      const TSQueryPredicateStep *args = steps + i + 1;
+      uint32_t arg_count = end - i - 1;
+      uint32_t length;
+      const char *name_value =
+          ts_query_string_value_for_id(query_, steps[i].value_id, &length);
+      std::string name(name_value, length);
+      i = end + 1;
+
+      auto string_arg = [&](uint32_t n) {
+        uint32_t length;
+        const char *value =
+            ts_query_string_value_for_id(query_, args[n].value_id, &length);
+        return std::string(value, length);
+      };
+      auto fail = [&](const char *message) {
+        *error = "#" + name + " in pattern " + std::to_string(pattern) + " " +
+                 message;
+        return false;
+      };
+
+      if (name.empty() || name.back() == '!' || name == "is?" ||
+          name == "is-not?") {
+        continue;
+      }
+
+      // any-of? is a predicate of its own, not the any- form of of?.
+      Predicate predicate;
+      std::string base = name;
+      predicate.all_nodes = base == "any-of?" || !starts_with(base, "any-");
+      if (!predicate.all_nodes) base = base.substr(4);
+      predicate.positive = !starts_with(base, "not-");
+      if (!predicate.positive) base = base.substr(4);
+      predicate.other_capture = kNoCapture;
+
+      if (arg_count == 0 || args[0].type != TSQueryPredicateStepTypeCapture) {
+        return fail("needs a capture as its first argument");
+      }
+      predicate.capture = args[0].value_id;
+
+      if (base == "eq?") {
+        predicate.kind = Kind::kEq;
+        if (arg_count != 2) return fail("takes two arguments");
+        if (args[1].type == TSQueryPredicateStepTypeCapture) {
+          predicate.other_capture = args[1].value_id;
+        } else {
+          predicate.values.push_back(string_arg(1));
+        }
+      } else if (base == "match?") {
+        predicate.kind = Kind::kMatch;
+        if (arg_count != 2 || args[1].type != TSQueryPredicateStepTypeString) {
+          return fail("takes a capture and a regular expression");
+        }
+        try {
+          predicate.regex = std::make_shared<std::regex>(string_arg(1));
+        } catch (const std::regex_error &e) {
+          return fail((std::string("has an invalid regular expression: ") +
+                       e.what()).c_str());
+        }
+      } else if (base == "any-of?") {
+        // Every node has to be one of the strings, or none of them.
+        predicate.kind = Kind::kAnyOf;
+        for (uint32_t n = 1; n < arg_count; n++) {
+          if (args[n].type != TSQueryPredicateStepTypeString) {
+            return fail("takes a capture and strings");
+          }
+          predicate.values.push_back(string_arg(n));
+        }
+      } else {
+        return fail("is not a supported predicate");
+      }
+      predicates_[pattern].push_back(std::move(predicate));
+    }
+  }
+  return true;
+}
+
+bool Query::Satisfies(const TSQueryMatch &match, const char *source,
+                      const CodePage *code_page, uint32_t byte_shift) const {
+  std::string text, other;
+  auto nodes_of = [&](uint32_t capture) {
+    std::vector<TSNode> nodes;
+    for (uint16_t i = 0; i < match.capture_count; i++) {
+      if (match.captures[i].index == capture) {
+        nodes.push_back(match.captures[i].node);
+      }
+    }
+    return nodes;
+  };
+
+  for (const Predicate &predicate : predicates_[match.pattern_index]) {
+    std::vector<TSNode> nodes = nodes_of(predicate.capture);
+
+    if (predicate.kind == Kind::kEq &&
+        predicate.other_capture != kNoCapture) {
+      // Captures are compared pairwise; both have to run out together.
+      std::vector<TSNode> others = nodes_of(predicate.other_capture);
+      size_t pairs = std::min(nodes.size(), others.size());
+      bool decided = false;
+      for (size_t i = 0; i < pairs && !decided; i++) {
+        node_text(nodes[i], source, code_page, byte_shift, &text);
+        node_text(others[i], source, code_page, byte_shift, &other);
+        bool holds = (text == other) == predicate.positive;
+        if (!holds && predicate.all_nodes) return false;
+        if (holds && !predicate.all_nodes) decided = true;
+      }
+      if (!decided && nodes.size() != others.size()) return false;
+      if (!decided && !predicate.all_nodes && pairs > 0) return false;
+      continue;
+    }
+
+    bool held = false;
+    for (const TSNode &node : nodes) {
+      node_text(node, source, code_page, byte_shift, &text);
+      bool found;
+      switch (predicate.kind) {
+        case Kind::kEq:
+          found = text == predicate.values[0];
+          break;
+        case Kind::kMatch:
+          found = std::regex_search(text, *predicate.regex);
+          break;
+        case Kind::kAnyOf:
+          found = false;
+          for (const std::string &value : predicate.values) {
+            if (text == value) {
+              found = true;
+              break;
+            }
+          }
+          break;
+      }
+      held = found == predicate.positive;
+      if (!held && predicate.all_nodes) return false;
+      if (held && !predicate.all_nodes) break;
+    }
+    // The any- forms need one node that satisfies them, if there are nodes.
+    if (!predicate.all_nodes && !nodes.empty() && !held) return false;
+  }
+  return true;
+}
+
+void run_query(const Query &query, TSNode root, const char *source,
+               const CodePage *code_page, QueryMatches *out) {
+  uint32_t byte_shift = code_page ? CodePageInput::kByteShift : 0;
+  // Not kept per thread: in arena mode whatever the cursor allocates is
+  // gone when the parse ends.
+  std::unique_ptr<TSQueryCursor, CursorDeleter> cursor(ts_query_cursor_new());
+  ts_query_cursor_exec(cursor.get(), query.query(), root);
+
+  TSQueryMatch match;
+  while (ts_query_cursor_next_match(cursor.get(), &match)) {
+    if (!query.Satisfies(match, source, code_page, byte_shift)) continue;
+    out->matches.push_back({match.pattern_index,
+                            static_cast<uint32_t>(out->captures.size()),
+                            match.capture_count});
+    for (uint16_t i = 0; i < match.capture_count; i++) {
+      TSNode node = match.captures[i].node;
+      TSPoint start = ts_node_start_point(node);
+      TSPoint end = ts_node_end_point(node);
+      out->captures.push_back(
+          {match.captures[i].index, ts_node_symbol(node),
+           ts_node_start_byte(node) >> byte_shift,
+           ts_node_end_byte(node) >> byte_shift, start.row,
+           start.column >> byte_shift, end.row, end.column >> byte_shift});
+    }
+  }
+}
+
+}  // namespace ts_native
@@ -0,0 +1,100 @@
+#ifndef TS_NATIVE_QUERY_H_
+#define TS_NATIVE_QUERY_H_
+
+#include <tree_sitter/api.h>
+
+#include "code_page.h"
+
+#include <cstdint>
+#include <memory>
+#include <regex>
+#include <string>
+#include <vector>
+
+namespace ts_native {
+
+// A tree-sitter query with its text predicates parsed once, so that matches
+// are filtered natively instead of in JS. #eq?, #match? and #any-of? are
+// evaluated with their not- and any- variants, with the semantics of the
+// tree-sitter CLI: a quantified capture must satisfy the predicate with
+// every node, or with one node for the any- forms. Directives (#set! ...)
+// and the property predicates #is? / #is-not? are accepted and ignored.
+//
+// A Query is immutable once compiled and shared by every thread; each run
+// uses its own TSQueryCursor.
+class Query {
+ public:
+  // Compiles `source` for `language`, or returns the Query compiled from the
+  // same text before. Queries are kept for the life of the process, like the
+  // languages they belong to. Returns null and sets `error` when the query
+  // or one of its predicates is invalid.
+  static const Query *Get(const TSLanguage *language, const std::string &source,
+                          std::string *error);
+
+  const TSQuery *query() const { return query_; }
+  uint32_t pattern_count() const;
+  std::vector<std::string> capture_names() const;
+
+  // Whether `match` satisfies the text predicates of its pattern. Node
+  // offsets are shifted right by `byte_shift` to index `source`, which is in
+  // `code_page` (null for UTF-8).
+  bool Satisfies(const TSQueryMatch &match, const char *source,
+                 const CodePage *code_page, uint32_t byte_shift) const;
+
+ private:
+  enum class Kind { kEq, kMatch, kAnyOf };
+
+  struct Predicate {
+    Kind kind;
+    bool positive;
+    // Whether every node of a quantified capture has to satisfy it.
+    bool all_nodes;
+    uint32_t capture;
+    // For #eq? against a second capture, its id; otherwise UINT32_MAX.
+    uint32_t other_capture;
+    // The string of #eq?, or the strings of #any-of?.
+    std::vector<std::string> values;
+    std::shared_ptr<std::regex> regex;
+  };
+
+  Query(TSQuery *query) : query_(query) {}
+  bool ParsePredicates(std::string *error);
+
+  TSQuery *query_;
+  // Text predicates by pattern index.
+  std::vector<std::vector<Predicate>> predicates_;
+};
+
+// Matches as (pattern, firstCapture, captureCount) triples, each capture as
+// (capture, symbol, startByte, endByte, startRow, startColumn, endRow,
+// endColumn).
+struct QueryCapture {
+  uint32_t capture;
+  uint32_t symbol;
+  uint32_t start_byte;
+  uint32_t end_byte;
+  uint32_t start_row;
+  uint32_t start_column;
+  uint32_t end_row;
+  uint32_t end_column;
+};
+
+struct QueryMatch {
+  uint32_t pattern;
+  uint32_t first_capture;
+  uint32_t capture_count;
+};
+
+struct QueryMatches {
+  std::vector<QueryMatch> matches;
+  std::vector<QueryCapture> captures;
+};
+
+// Runs `query` over `root` and keeps the matches whose predicates hold.
+// Offsets in the output are in bytes of `source`, as for the other results.
+void run_query(const Query &query, TSNode root, const char *source,
+               const CodePage *code_page, QueryMatches *out);
+
+}  // namespace ts_native
+
+#endif  // TS_NATIVE_QUERY_H_
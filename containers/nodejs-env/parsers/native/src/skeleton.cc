@@ -0,0 +1,443 @@
+#include "skeleton.h"
+
+#include "source_areas.h"
+
+namespace ts_native {
+
+namespace {
+
+const uint32_t kIndicatorColumn = 6;
+const uint32_t kAreaBStart = 11;
+
+struct Token {
+  enum Type { kNone, kWord, kLiteral, kPeriod, kOther };
+  Type type;
+  uint32_t start;
+  uint32_t end;
+  uint32_t row;
+  uint32_t column;
+  // The text without quotes, for literals.
+  uint32_t name_start;
+  uint32_t name_end;
+};
+
+// What each byte is to the tokenizer, looked up in a table built for the
+// code page so the scan never decodes.
+enum CharClass : uint8_t {
+  kOtherChar,
+  kSeparatorChar,
+  kWordChar,
+  kQuoteChar,
+  kPeriodChar,
+  kAsteriskChar,
+};
+
+CharClass char_class(uint32_t c) {
+  if (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == ',' ||
+      c == ';') {
+    return kSeparatorChar;
+  }
+  if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') ||
+      (c >= '0' && c <= '9') || c == '-' || c == '_' || c >= 0x80) {
+    return kWordChar;
+  }
+  if (c == '"' || c == '\'') return kQuoteChar;
+  if (c == '.') return kPeriodChar;
+  if (c == '*') return kAsteriskChar;
+  return kOtherChar;
+}
+
+// Matches the tokens of the source area against the landmark patterns, one
+// token at a time.
+class SkeletonScanner {
+ public:
+  SkeletonScanner(const char *text, const CodePage *code_page,
+                  std::vector<Landmark> *landmarks)
+      : text_(text), code_page_(code_page), landmarks_(landmarks) {
+    for (uint32_t byte = 0; byte < 256; byte++) {
+      classes_[byte] =
+          char_class(code_page ? code_page->to_unicode[byte] : byte);
+    }
+  }
+
+  uint32_t at(uint32_t i) const {
+    unsigned char byte = text_[i];
+    return code_page_ ? code_page_->to_unicode[byte] : byte;
+  }
+
+  CharClass class_at(uint32_t i) const {
+    return classes_[static_cast<unsigned char>(text_[i])];
+  }
+
+  void scan_range(const TSRange &range);
+  void directive(const CommentLine &line);
+
+ private:
+  enum Expect { kNothing, kProgramName, kCopyName, kCallTarget, kProgram,
+                kEndProgramName };
+
+  // Whether `token` is `keyword` (upper case) in any case.
+  bool is(const Token &token, const char *keyword) const {
+    if (token.type != Token::kWord) return false;
+    uint32_t i = token.start;
+    for (; *keyword; keyword++, i++) {
+      if (i == token.end) return false;
+      uint32_t c = at(i);
+      if (c >= 'a' && c <= 'z') c -= 'a' - 'A';
+      if (c != static_cast<unsigned char>(*keyword)) return false;
+    }
+    return i == token.end;
+  }
+
+  bool is_division(const Token &token) const {
+    return is(token, "IDENTIFICATION") || is(token, "ID") ||
+           is(token, "ENVIRONMENT") || is(token, "DATA") ||
+           is(token, "PROCEDURE");
+  }
+
+  void emit(LandmarkKind kind, const Token &first, uint32_t end,
+            const Token &name) {
+    landmarks_->push_back({kind, first.start, end, first.row, name.name_start,
+                           name.name_end});
+  }
+
+  void token(const Token &token);
+
+  const char *text_;
+  const CodePage *code_page_;
+  std::vector<Landmark> *landmarks_;
+  CharClass classes_[256];
+  Token previous_ = {};
+  bool previous_starts_sentence_ = false;
+  Expect expect_ = kNothing;
+  Token anchor_ = {};
+  bool in_procedure_ = false;
+};
+
+void SkeletonScanner::scan_range(const TSRange &range) {
+  uint32_t i = range.start_byte;
+  uint32_t end = range.end_byte;
+  Token token;
+  token.row = range.start_point.row;
+  // A continuation line's range starts at its '-' indicator.
+  if (range.start_point.column == kIndicatorColumn) i++;
+
+  while (i < end) {
+    CharClass c = class_at(i);
+    if (c == kSeparatorChar) {
+      i++;
+      continue;
+    }
+    token.start = i;
+    token.column = range.start_point.column + (i - range.start_byte);
+    if (c == kAsteriskChar && i + 1 < end && at(i + 1) == '>') {
+      // A floating comment runs to the end of the line.
+      return;
+    } else if (c == kQuoteChar) {
+      char quote = text_[i];
+      uint32_t j = i + 1;
+      while (j < end && text_[j] != quote) j++;
+      token.type = Token::kLiteral;
+      token.name_start = i + 1;
+      token.name_end = j;
+      i = j < end ? j + 1 : end;
+    } else if (c == kWordChar) {
+      uint32_t j = i + 1;
+      while (j < end && class_at(j) == kWordChar) j++;
+      token.type = Token::kWord;
+      token.name_start = i;
+      token.name_end = j;
+      i = j;
+    } else if (c == kPeriodChar &&
+               (i + 1 == end || class_at(i + 1) == kSeparatorChar)) {
+      token.type = Token::kPeriod;
+      token.name_start = token.name_end = ++i;
+    } else {
+      token.type = Token::kOther;
+      token.name_start = token.name_end = ++i;
+    }
+    token.end = i;
+    this->token(token);
+  }
+}
+
+void SkeletonScanner::token(const Token &token) {
+  bool starts_sentence =
+      previous_.type == Token::kNone || previous_.type == Token::kPeriod;
+  bool named = token.type == Token::kWord || token.type == Token::kLiteral;
+  Expect expect = expect_;
+  expect_ = kNothing;
+
+  if (expect == kProgramName && token.type == Token::kPeriod &&
+      previous_.type == Token::kWord && is(previous_, "PROGRAM-ID")) {
+    // PROGRAM-ID. name
+    expect_ = kProgramName;
+  } else if (expect == kProgramName && named) {
+    emit(kLandmarkProgram, anchor_, token.end, token);
+  } else if (expect == kCopyName && named) {
+    emit(kLandmarkCopy, anchor_, token.end, token);
+  } else if (expect == kCallTarget && named) {
+    emit(kLandmarkCall, anchor_, token.end, token);
+  } else if (expect == kProgram && is(token, "PROGRAM")) {
+    expect_ = kEndProgramName;
+  } else if (expect == kEndProgramName && named) {
+    emit(kLandmarkEndProgram, anchor_, token.end, token);
+  } else if (token.type == Token::kWord) {
+    if (is(token, "DIVISION") && is_division(previous_)) {
+      emit(kLandmarkDivision, previous_, token.end, previous_);
+      in_procedure_ = is(previous_, "PROCEDURE");
+    } else if (is(token, "SECTION") && previous_.type == Token::kWord &&
+               previous_starts_sentence_) {
+      emit(kLandmarkSection, previous_, token.end, previous_);
+    } else if (is(token, "PROGRAM-ID")) {
+      expect_ = kProgramName;
+    } else if (is(token, "COPY")) {
+      expect_ = kCopyName;
+    } else if (is(token, "CALL")) {
+      expect_ = kCallTarget;
+    } else if (is(token, "END")) {
+      expect_ = kProgram;
+    }
+    if (expect_ != kNothing) anchor_ = token;
+  } else if (token.type == Token::kPeriod && in_procedure_ &&
+             previous_.type == Token::kWord && previous_starts_sentence_ &&
+             previous_.column < kAreaBStart &&
+             !is(previous_, "DECLARATIVES")) {
+    emit(kLandmarkParagraph, previous_, token.end, previous_);
+  }
+
+  previous_ = token;
+  previous_starts_sentence_ = starts_sentence;
+}
+
+// ?SEARCH and ?SOURCE, among the directives of a line: "?SEARCH $A.B.C",
+// "?SEARCH ($A.B.C, $A.B.D)", "?SOURCE $A.B.E (SECTION-1, SECTION-2)".
+// Directives are separated by commas, except within a SEARCH list.
+void SkeletonScanner::directive(const CommentLine &line) {
+  enum { kKeyword, kSearchFiles, kSourceFile, kIgnored } state = kKeyword;
+  uint32_t i = line.start_byte;
+  while (i < line.end_byte && at(i) != '?') i++;
+  Token first = {};
+  first.start = i;
+  first.row = line.row;
+  uint32_t depth = 0;
+  for (i++; i < line.end_byte;) {
+    uint32_t c = at(i);
+    if (c == ' ' || c == '\t' || c == '\r' || c == ',' || c == '(' ||
+        c == ')') {
+      if (c == '(') depth++;
+      if (c == ')' && depth > 0) depth--;
+      if (c == ',' && depth == 0 && state != kSearchFiles) state = kKeyword;
+      i++;
+      continue;
+    }
+    Token name = {};
+    name.type = Token::kWord;
+    name.name_start = name.start = i;
+    while (i < line.end_byte) {
+      c = at(i);
+      if (c == ' ' || c == '\t' || c == '\r' || c == ',' || c == '(' ||
+          c == ')') {
+        break;
+      }
+      i++;
+    }
+    name.name_end = name.end = i;
+    if (state == kKeyword) {
+      state = is(name, "SEARCH")   ? kSearchFiles
+              : is(name, "SOURCE") ? kSourceFile
+                                   : kIgnored;
+    } else if (state == kSearchFiles) {
+      emit(kLandmarkSearch, first, line.end_byte, name);
+    } else if (state == kSourceFile) {
+      // What follows the file are the sections taken from it.
+      emit(kLandmarkSource, first, line.end_byte, name);
+      state = kIgnored;
+    }
+  }
+}
+
+// One line of a .gensrc module, read left to right.
+class GensrcLine {
+ public:
+  GensrcLine(const char *text, uint32_t start, uint32_t end,
+             const CodePage *code_page)
+      : text_(text), i_(start), end_(end), code_page_(code_page) {}
+
+  uint32_t position() const { return i_; }
+
+  uint32_t peek() const {
+    if (i_ == end_) return 0;
+    unsigned char byte = text_[i_];
+    return code_page_ ? code_page_->to_unicode[byte] : byte;
+  }
+
+  // Skips the statement number gutter; returns whether it had a number.
+  bool skip_gutter() {
+    skip_blanks();
+    bool numbered = is_digit(peek());
+    while (is_digit(peek())) i_++;
+    while (peek() == ' ' || peek() == '!') i_++;
+    return numbered;
+  }
+
+  void skip_blanks() {
+    while (peek() == ' ' || peek() == '\t') i_++;
+  }
+
+  // Matches `word` exactly, as the grammar's keywords are, and moves past
+  // it and the blanks after it.
+  bool word(const char *word) {
+    uint32_t j = i_;
+    for (; *word; word++, j++) {
+      if (j == end_ || at(j) != static_cast<unsigned char>(*word)) return false;
+    }
+    if (j < end_ && is_name_char(at(j))) return false;
+    i_ = j;
+    skip_blanks();
+    return true;
+  }
+
+  bool punctuation(const char *chars) {
+    uint32_t j = i_;
+    for (; *chars; chars++, j++) {
+      if (j == end_ || at(j) != static_cast<unsigned char>(*chars)) return false;
+    }
+    i_ = j;
+    skip_blanks();
+    return true;
+  }
+
+  // Reads a run of characters accepted by `accept` into [*start, *end).
+  template <typename Accept>
+  bool run(Accept accept, uint32_t *start, uint32_t *end) {
+    *start = i_;
+    while (i_ < end_ && accept(at(i_))) i_++;
+    *end = i_;
+    skip_blanks();
+    return *end > *start;
+  }
+
+  bool name(uint32_t *start, uint32_t *end) {
+    return run(is_name_char, start, end);
+  }
+
+  static bool is_digit(uint32_t c) { return c >= '0' && c <= '9'; }
+  static bool is_name_char(uint32_t c) {
+    return is_digit(c) || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') ||
+           c == '_';
+  }
+
+ private:
+  uint32_t at(uint32_t i) const {
+    unsigned char byte = text_[i];
+    return code_page_ ? code_page_->to_unicode[byte] : byte;
+  }
+
+  const char *text_;
+  uint32_t i_;
+  uint32_t end_;
+  const CodePage *code_page_;
+};
+
+}  // namespace
+
+void extract_cobol_skeleton(const char *text, uint32_t length,
+                            const CodePage *code_page,
+                            std::vector<Landmark> *landmarks) {
+  landmarks->clear();
+  SourceAreas areas;
+  scan_fixed_format(text, length, &areas, code_page);
+  SkeletonScanner scanner(text, code_page, landmarks);
+  // Both lists are in source order; landmarks are too.
+  size_t comment = 0;
+  for (const TSRange &range : areas.ranges) {
+    for (; comment < areas.comments.size() &&
+           areas.comments[comment].start_byte < range.start_byte;
+         comment++) {
+      if (areas.comments[comment].indicator == '?') {
+        scanner.directive(areas.comments[comment]);
+      }
+    }
+    scanner.scan_range(range);
+  }
+  for (; comment < areas.comments.size(); comment++) {
+    if (areas.comments[comment].indicator == '?') {
+      scanner.directive(areas.comments[comment]);
+    }
+  }
+}
+
+void extract_coolgen_skeleton(const char *text, uint32_t length,
+                              const CodePage *code_page,
+                              std::vector<Landmark> *landmarks) {
+  landmarks->clear();
+  bool in_header = true;
+  bool module_seen = false;
+  // The kind of the views listed under the current block header.
+  int view_kind = -1;
+  uint32_t row = 0;
+  uint32_t line_start = 0;
+  while (line_start < length) {
+    const char *newline =
+        find_line_end(text + line_start, text + length, code_page);
+    uint32_t line_end = newline ? newline - text : length;
+    GensrcLine line(text, line_start, line_end, code_page);
+    bool numbered = line.skip_gutter();
+    uint32_t start = line.position();
+    uint32_t name_start, name_end;
+    auto emit = [&](LandmarkKind kind) {
+      landmarks->push_back({kind, start, name_end, row, name_start, name_end});
+    };
+
+    if (!in_header) {
+      while (line.peek() == '*') line.punctuation("*");
+      start = line.position();
+      if (numbered && line.word("USE") && line.name(&name_start, &name_end)) {
+        emit(kLandmarkUse);
+      }
+    } else if (!module_seen && line.punctuation("+->")) {
+      module_seen = true;
+      if (line.name(&name_start, &name_end)) emit(kLandmarkProgram);
+      auto is_date = [](uint32_t c) {
+        return GensrcLine::is_digit(c) || c == '/';
+      };
+      auto is_time = [](uint32_t c) {
+        return GensrcLine::is_digit(c) || c == ':';
+      };
+      start = line.position();
+      if (line.run(is_date, &name_start, &name_end)) emit(kLandmarkDate);
+      start = line.position();
+      if (line.run(is_time, &name_start, &name_end)) emit(kLandmarkTime);
+    } else if (line.word("IMPORTS")) {
+      view_kind = kLandmarkImportView;
+    } else if (line.word("EXPORTS")) {
+      view_kind = kLandmarkExportView;
+    } else if (line.word("LOCALS")) {
+      view_kind = kLandmarkLocalView;
+    } else if (line.word("ENTITY") && line.word("ACTIONS")) {
+      view_kind = kLandmarkEntityActionView;
+    } else if ((line.word("PROCEDURE") && line.word("STATEMENTS")) ||
+               (line.word("EXTERNAL") && line.word("ACTION") &&
+                line.word("BLOCK"))) {
+      in_header = false;
+    } else if (view_kind >= 0 && line.word("Group") && line.word("View")) {
+      // Group View (30) name: the number is the group's cardinality.
+      if (line.punctuation("(")) {
+        line.run(GensrcLine::is_digit, &name_start, &name_end);
+        line.punctuation(")");
+      }
+      if (line.name(&name_start, &name_end)) {
+        emit(static_cast<LandmarkKind>(view_kind));
+      }
+    } else if (view_kind >= 0 && (line.word("Work") || line.word("Entity")) &&
+               line.word("View") && line.name(&name_start, &name_end)) {
+      emit(static_cast<LandmarkKind>(view_kind));
+    }
+
+    line_start = newline ? line_end + 1 : length;
+    row++;
+  }
+}
+
+}  // namespace ts_native
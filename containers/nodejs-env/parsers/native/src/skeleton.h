@@ -0,0 +1,89 @@
+#ifndef TS_NATIVE_SKELETON_H_
+#define TS_NATIVE_SKELETON_H_
+
+#include "code_page.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace ts_native {
+
+enum LandmarkKind : uint32_t {
+  kLandmarkProgram = 0,
+  kLandmarkDivision = 1,
+  kLandmarkSection = 2,
+  kLandmarkParagraph = 3,
+  kLandmarkCopy = 4,
+  kLandmarkCall = 5,
+  kLandmarkEndProgram = 6,
+  // CoolGen only.
+  kLandmarkImportView = 7,
+  kLandmarkExportView = 8,
+  kLandmarkEntityActionView = 9,
+  kLandmarkLocalView = 10,
+  kLandmarkUse = 11,
+  kLandmarkDate = 12,
+  kLandmarkTime = 13,
+  // COBOL again, from Tandem compiler directives.
+  kLandmarkSearch = 14,
+  kLandmarkSource = 15,
+};
+
+// One landmark of a program, from its first keyword to its last token.
+// `name_start`/`name_end` delimit what it names, without quotes: the program,
+// the division keyword, the section or paragraph, the copybook or the called
+// program, the view, the used module, the date or time itself, or the file
+// a directive refers to.
+struct Landmark {
+  uint32_t kind;
+  uint32_t start_byte;
+  uint32_t end_byte;
+  uint32_t row;
+  uint32_t name_start;
+  uint32_t name_end;
+};
+
+// Finds the landmarks of a fixed-format COBOL document without parsing it,
+// for indexers that need its outline and dependencies and not its tree:
+//
+//   PROGRAM-ID. name          kLandmarkProgram
+//   X DIVISION                kLandmarkDivision, X being IDENTIFICATION, ID,
+//                             ENVIRONMENT, DATA or PROCEDURE
+//   name SECTION              kLandmarkSection, in any division
+//   name.                     kLandmarkParagraph, starting in area A of the
+//                             PROCEDURE DIVISION
+//   COPY name                 kLandmarkCopy
+//   CALL name                 kLandmarkCall, a literal or an identifier
+//   END PROGRAM name          kLandmarkEndProgram
+//   ?SEARCH file, ...         kLandmarkSearch, one per object file searched
+//   ?SOURCE file (sections)   kLandmarkSource, naming the source file
+//
+// The source area is taken from scan_fixed_format, so comment lines, the
+// sequence and identification areas are skipped the way the parser skips
+// them, and the rest is split into words, literals and separator periods
+// in one pass. Directive lines, which scan_fixed_format leaves out with the
+// comments, are read on their own. Offsets are in bytes of `text`, which is
+// in `code_page` (null for UTF-8).
+void extract_cobol_skeleton(const char *text, uint32_t length,
+                            const CodePage *code_page,
+                            std::vector<Landmark> *landmarks);
+
+// The same for a CoolGen .gensrc module, in one pass over its lines:
+//
+//   +-> name date time        kLandmarkProgram, kLandmarkDate, kLandmarkTime
+//   Work|Entity View name     kLandmarkImportView, kLandmarkExportView,
+//   Group View (n) name       kLandmarkEntityActionView or kLandmarkLocalView,
+//                             by the IMPORTS:, EXPORTS:, ENTITY ACTIONS: or
+//                             LOCALS: block it is in
+//   USE name                  kLandmarkUse, in the procedure statements
+//
+// Each line is read past its gutter the way the external scanner reads it:
+// blanks, the statement number, then the blanks and '!' nesting bars. Only
+// numbered lines can hold a USE statement.
+void extract_coolgen_skeleton(const char *text, uint32_t length,
+                              const CodePage *code_page,
+                              std::vector<Landmark> *landmarks);
+
+}  // namespace ts_native
+
+#endif  // TS_NATIVE_SKELETON_H_
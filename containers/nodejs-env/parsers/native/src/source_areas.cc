@@ -0,0 +1,96 @@
+#include "source_areas.h"
+
+namespace ts_native {
+
+namespace {
+
+const uint32_t kIndicatorColumn = 6;
+const uint32_t kAreaBEnd = 72;
+
+void add_range(SourceAreas *areas, uint32_t start, TSPoint start_point,
+               uint32_t end, TSPoint end_point) {
+  if (start < end) {
+    areas->ranges.push_back({start_point, end_point, start, end});
+  }
+}
+
+// The byte offset in `line` of the character in column `column` (0-based),
+// or `length` when the line is shorter. Code-page characters are one byte;
+// UTF-8 ones are counted by their lead bytes, as the scanner counts columns.
+uint32_t column_offset(const char *line, uint32_t length, uint32_t column,
+                       const CodePage *code_page) {
+  if (code_page) return column < length ? column : length;
+  uint32_t offset = 0;
+  for (uint32_t characters = 0; offset < length; offset++) {
+    if ((static_cast<unsigned char>(line[offset]) & 0xC0) == 0x80) continue;
+    if (characters++ == column) break;
+  }
+  return offset;
+}
+
+}  // namespace
+
+void scan_fixed_format(const char *text, uint32_t length, SourceAreas *areas,
+                       const CodePage *code_page) {
+  areas->ranges.clear();
+  areas->comments.clear();
+
+  uint32_t row = 0;
+  uint32_t line_start = 0;
+  while (line_start < length) {
+    const char *newline =
+        find_line_end(text + line_start, text + length, code_page);
+    uint32_t line_end = newline ? newline - text : length;
+    uint32_t next = newline ? line_end + 1 : length;
+    uint32_t line_length = line_end - line_start;
+    // Where a range that takes in the newline ends.
+    TSPoint next_point = newline ? TSPoint{row + 1, 0} : TSPoint{row, line_length};
+
+    const char *line = text + line_start;
+    uint32_t indicator_offset =
+        column_offset(line, line_length, kIndicatorColumn, code_page);
+    uint32_t indicator = ' ';
+    if (indicator_offset < line_length) {
+      unsigned char byte = line[indicator_offset];
+      indicator = code_page ? code_page->to_unicode[byte] : byte;
+    }
+    if (line_length > 0) {
+      // Tandem compiler directives start in column 1 as well.
+      unsigned char byte = text[line_start];
+      if ((code_page ? code_page->to_unicode[byte] : byte) == '?') {
+        indicator = '?';
+      }
+    }
+    if (indicator == '*' || indicator == '/' || indicator == '?') {
+      areas->comments.push_back({row, line_start, line_end, indicator});
+    } else if (indicator_offset < line_length) {
+      // Points count bytes, like the runtime's.
+      uint32_t column = indicator == '-' ? indicator_offset
+                                         : column_offset(line, line_length,
+                                                         kIndicatorColumn + 1,
+                                                         code_page);
+      uint32_t area_b_end =
+          column_offset(line, line_length, kAreaBEnd, code_page);
+      TSPoint start_point = {row, column};
+      if (area_b_end < line_length) {
+        add_range(areas, line_start + column, start_point,
+                  line_start + area_b_end, TSPoint{row, area_b_end});
+        add_range(areas, line_end, TSPoint{row, line_length}, next,
+                  next_point);
+      } else {
+        add_range(areas, line_start + column, start_point, next, next_point);
+      }
+    }
+
+    line_start = next;
+    row++;
+  }
+
+  // An empty list would make the parser read the whole document.
+  if (areas->ranges.empty()) {
+    TSPoint end = {row, 0};
+    areas->ranges.push_back({end, end, length, length});
+  }
+}
+
+}  // namespace ts_native
@@ -0,0 +1,51 @@
+#ifndef TS_NATIVE_SOURCE_AREAS_H_
+#define TS_NATIVE_SOURCE_AREAS_H_
+
+#include <tree_sitter/api.h>
+
+#include "code_page.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace ts_native {
+
+// A fixed-format comment line ('*' or '/' in the indicator column) or
+// compiler-directive line ('?'), reported beside the tree instead of
+// becoming a node in it.
+struct CommentLine {
+  uint32_t row;
+  uint32_t start_byte;
+  uint32_t end_byte;
+  uint32_t indicator;
+};
+
+// The parts of a fixed-format COBOL source the parser actually needs to see.
+//
+//   columns 1-6    sequence area          dropped
+//   column  7      indicator area         dropped, except on '-' lines
+//   columns 8-72   area A / area B        kept, together with the newline
+//   columns 73-    identification area    dropped
+//
+// Continuation lines keep their '-' indicator so the scanner's
+// multiline_string rule can still join literals across lines, and comment
+// lines are dropped whole and listed in `comments`. So are compiler-directive
+// lines, '?' in the indicator area or in column 1 as Tandem writes them,
+// with '?' as their indicator. The parse must run with the grammar's
+// set_source_areas_stripped hook switched on (see grammar.h). Columns are
+// counted in characters, as the scanner counts them: code points in UTF-8,
+// where a character before column 73 may take several bytes, and bytes with
+// a `code_page`. The ranges and their points are in bytes all the same. With
+// a `code_page` the line ends and indicators are looked for in that
+// encoding, and `indicator` is the decoded character.
+struct SourceAreas {
+  std::vector<TSRange> ranges;
+  std::vector<CommentLine> comments;
+};
+
+void scan_fixed_format(const char *text, uint32_t length, SourceAreas *areas,
+                       const CodePage *code_page = nullptr);
+
+}  // namespace ts_native
+
+#endif  // TS_NATIVE_SOURCE_AREAS_H_
@@ -0,0 +1,145 @@
+// Parses a fixed-format COBOL program in UTF-8 and the same program encoded
+// in CP037, with and without fixed_format. The CP037 parse is decoded while
+// parsing, yet its S-expression, flat tree, data flow tokens, variables and
+// edges and query captures must be those of the UTF-8 parse, offsets and
+// columns included: they are all in the bytes of the source as given, and
+// every character is one byte in both. Exits with 1 when a check fails.
+//
+// Built by CMakeLists.txt (target code_page_test) and run by ctest.
+
+#include "batch_parse.h"
+#include "languages.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+extern "C" void tree_sitter_COBOL_external_scanner_set_source_areas_stripped(bool);
+
+using namespace ts_native;
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string &what) {
+  if (condition) return;
+  fprintf(stderr, "FAILED: %s\n", what.c_str());
+  failures++;
+}
+
+// `text` in `code_page`; every character of it has to be in the code page.
+std::string encode(const std::string &text, const CodePage &code_page) {
+  std::string out;
+  for (unsigned char c : text) {
+    for (uint32_t byte = 0; byte < 256; byte++) {
+      if (code_page.to_unicode[byte] == c) {
+        out += static_cast<char>(byte);
+        break;
+      }
+    }
+  }
+  return out;
+}
+
+template <typename T>
+bool same(const std::vector<T> &a, const std::vector<T> &b) {
+  return a.size() == b.size() &&
+         (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+}
+
+// The MOVE and ADD operands of the COBOL binding's data flow rules.
+const char *const statements[] = {"move_statement", "add_statement", nullptr};
+const char *const references[] = {"qualified_word", nullptr};
+const char *const subscripts[] = {"subref", "refmod", nullptr};
+const char *const skipped[] = {"comment", "comment_entry", nullptr};
+const DataFlowOperand operands[] = {
+    {"move_statement", "src", OperandRole::kUse, false},
+    {"move_statement", "dst", OperandRole::kDef, false},
+    {"add_statement", "from", OperandRole::kUse, false},
+    {"add_statement", "to", OperandRole::kUseDef, false},
+    {"add_statement", "giving", OperandRole::kDef, false},
+    {nullptr, nullptr, OperandRole::kUse, false},
+};
+const DataFlowRules rules = {statements, references, subscripts, skipped,
+                             operands};
+
+}  // namespace
+
+int main() {
+  const TSLanguage *language = ts_languages_get("COBOL");
+  const CodePage *cp037 = find_code_page("cp037");
+  if (!language || !cp037) {
+    fprintf(stderr, "COBOL or cp037 is not built into this test\n");
+    return 1;
+  }
+  Grammar grammar = {
+      "COBOL", language,
+      tree_sitter_COBOL_external_scanner_set_source_areas_stripped,
+      false, &rules, false, nullptr, false};
+
+  std::string error;
+  const Query *query = Query::Get(
+      language, "(move_statement src: (_) @src dst: (_) @dst)", &error);
+  if (!query) {
+    fprintf(stderr, "query: %s\n", error.c_str());
+    return 1;
+  }
+
+  std::string source =
+      "000100 IDENTIFICATION DIVISION.\n"
+      "000200 PROGRAM-ID. EBCDIC.\n"
+      "000300* MOVE NOTHING TO ANYTHING.\n"
+      "000400 PROCEDURE DIVISION.\n"
+      "000500     MOVE \"QUOTED\" TO NAME-1.\n"
+      "000600     MOVE NAME-1 TO NAME-2.\n"
+      "000700     ADD NAME-2 TO TOTAL GIVING RESULT.\n";
+  std::string ebcdic = encode(source, *cp037);
+  check(ebcdic.size() == source.size(), "encoded");
+
+  for (bool fixed_format : {false, true}) {
+    std::string name = fixed_format ? "fixed_format: " : "whole lines: ";
+    ParseOptions options;
+    options.fixed_format = fixed_format;
+    options.include_sexp = true;
+    options.include_flat = true;
+    options.data_flow = true;
+    options.query = query;
+
+    ParseResult utf8;
+    parse_source(grammar, options, source.data(),
+                 static_cast<uint32_t>(source.size()), &utf8);
+    check(utf8.error.empty(), name + "utf-8: " + utf8.error);
+
+    options.code_page = cp037;
+    ParseResult decoded;
+    parse_source(grammar, options, ebcdic.data(),
+                 static_cast<uint32_t>(ebcdic.size()), &decoded);
+    check(decoded.error.empty(), name + "cp037: " + decoded.error);
+
+    check(decoded.sexp == utf8.sexp,
+          name + "sexp: " + decoded.sexp + "\n  utf-8: " + utf8.sexp);
+    check(decoded.node_count == utf8.node_count, name + "node count");
+    check(decoded.error_count == utf8.error_count, name + "error count");
+    check(decoded.flat.size() == utf8.flat.size() && utf8.flat.data() &&
+              memcmp(decoded.flat.data(), utf8.flat.data(),
+                     utf8.flat.size()) == 0,
+          name + "flat tree offsets and columns");
+
+    check(!utf8.data_flow.tokens.empty(), name + "data flow: some tokens");
+    check(same(decoded.data_flow.tokens, utf8.data_flow.tokens),
+          name + "data flow: token offsets");
+    check(decoded.data_flow.variables == utf8.data_flow.variables,
+          name + "data flow: variable names");
+    check(same(decoded.data_flow.edges, utf8.data_flow.edges) &&
+              same(decoded.data_flow.sources, utf8.data_flow.sources),
+          name + "data flow: edges");
+
+    check(utf8.query_matches.matches.size() == 2, name + "query: two MOVEs");
+    check(same(decoded.query_matches.captures, utf8.query_matches.captures),
+          name + "query: capture offsets");
+  }
+
+  if (failures == 0) printf("code_page_test: all checks passed\n");
+  return failures == 0 ? 0 : 1;
+}
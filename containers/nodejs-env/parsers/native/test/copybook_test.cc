@@ -0,0 +1,134 @@
+// Expands COPY statements against copybooks written to a temporary
+// directory: nested copybooks, one copybook under different REPLACING
+// phrases and after it changes, a missing copybook and a COPY cycle. Every
+// expansion goes through the one process-wide copybook cache. Exits with 1
+// when a check fails.
+//
+// Built by CMakeLists.txt (target copybook_test) and run by ctest.
+
+#include "copybook.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+
+using namespace ts_native;
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string &what) {
+  if (condition) return;
+  fprintf(stderr, "FAILED: %s\n", what.c_str());
+  failures++;
+}
+
+bool contains(const std::string &text, const std::string &part) {
+  return text.find(part) != std::string::npos;
+}
+
+bool has_error(const ExpandedSource &source, const std::string &part) {
+  for (const CopyError &error : source.errors) {
+    if (contains(error.message, part)) return true;
+  }
+  return false;
+}
+
+void write(const std::string &path, const std::string &text) {
+  FILE *file = fopen(path.c_str(), "wb");
+  if (!file) {
+    perror(path.c_str());
+    exit(1);
+  }
+  fwrite(text.data(), 1, text.size(), file);
+  fclose(file);
+}
+
+ExpandedSource expand(const std::string &directory, const std::string &text) {
+  ExpandedSource out;
+  expand_copybooks(directory + "/MAIN.cbl", text, CopybookOptions(), &out);
+  return out;
+}
+
+}  // namespace
+
+int main() {
+  char directory_template[] = "/tmp/copybook_test.XXXXXX";
+  if (!mkdtemp(directory_template)) {
+    perror("mkdtemp");
+    return 1;
+  }
+  std::string directory = directory_template;
+  const char *copybooks[][2] = {
+      {"OUTER.cpy", "       01  OUTER-GROUP.\n"
+                    "       COPY INNER.\n"},
+      {"INNER.cpy", "           05  INNER-FIELD PIC X.\n"},
+      {"ITEM.cpy", "       01  ITEM-NAME PIC 9(4).\n"},
+      {"LOOP-A.cpy", "       COPY LOOP-B.\n"},
+      {"LOOP-B.cpy", "       COPY LOOP-A.\n"},
+  };
+  for (const auto &copybook : copybooks) {
+    write(directory + "/" + copybook[0], copybook[1]);
+  }
+
+  ExpandedSource nested = expand(directory,
+                                 "       WORKING-STORAGE SECTION.\n"
+                                 "       COPY OUTER.\n");
+  check(nested.errors.empty(), "nested: no errors");
+  check(contains(nested.text, "OUTER-GROUP") &&
+            contains(nested.text, "INNER-FIELD"),
+        "nested: both copybooks spliced in");
+  check(!contains(nested.text, "COPY"), "nested: COPY statements blanked");
+  check(nested.files.size() == 3, "nested: program and two copybooks");
+
+  // The same copybook under three REPLACING phrases, each of which must get
+  // its own expansion from the cache.
+  const char *replacements[] = {"AMOUNT", "TOTAL", nullptr};
+  for (const char *replacement : replacements) {
+    std::string copy = "       COPY ITEM";
+    if (replacement) {
+      copy += " REPLACING ==ITEM-NAME== BY ==" + std::string(replacement) +
+              "==";
+    }
+    ExpandedSource replaced = expand(directory, copy + ".\n");
+    std::string expected = replacement ? replacement : "ITEM-NAME";
+    check(replaced.errors.empty(), "REPLACING " + expected + ": no errors");
+    check(contains(replaced.text, " " + expected + " PIC 9(4)."),
+          "REPLACING " + expected + ": " + replaced.text);
+    for (const char *other : {"AMOUNT", "TOTAL"}) {
+      if (expected != other) {
+        check(!contains(replaced.text, other),
+              "REPLACING " + expected + ": no " + other);
+      }
+    }
+  }
+
+  // A copybook that changes is expanded again rather than served from the
+  // cache. The new text has another size, so the change shows even within
+  // the mtime's resolution.
+  write(directory + "/ITEM.cpy", "       01  ITEM-NAME PIC 9(10).\n");
+  ExpandedSource changed = expand(
+      directory, "       COPY ITEM REPLACING ==ITEM-NAME== BY ==AMOUNT==.\n");
+  check(contains(changed.text, " AMOUNT PIC 9(10)."),
+        "changed copybook: " + changed.text);
+
+  ExpandedSource missing = expand(directory, "       COPY MISSING.\n");
+  check(missing.errors.size() == 1 &&
+            has_error(missing, "copybook MISSING not found"),
+        "missing: reported");
+  check(contains(missing.text, "COPY MISSING."), "missing: COPY kept");
+
+  ExpandedSource cycle = expand(directory, "       COPY LOOP-A.\n");
+  check(has_error(cycle, "recursive COPY"), "cycle: reported");
+
+  for (const auto &copybook : copybooks) {
+    unlink((directory + "/" + copybook[0]).c_str());
+  }
+  rmdir(directory.c_str());
+
+  if (failures == 0) printf("copybook_test: all checks passed\n");
+  return failures == 0 ? 0 : 1;
+}
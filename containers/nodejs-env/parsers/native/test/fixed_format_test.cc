@@ -0,0 +1,105 @@
+// Parses a fixed-format COBOL program with sequence numbers, a comment line
+// and an identification area three ways on one thread. First through
+// parse_source with fixed_format. Then through parse_source without it,
+// where the scanner has to read those areas as extras again: stripped mode
+// is only switched by parse_source and must be off after it. Last through a
+// parser given the ranges of scan_fixed_format directly, which gets the
+// same tree by switching stripped mode around the parse the same way.
+// Exits with 1 when a check fails.
+//
+// Built by CMakeLists.txt (target fixed_format_test) and run by ctest.
+
+#include "batch_parse.h"
+#include "languages.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+extern "C" void tree_sitter_COBOL_external_scanner_set_source_areas_stripped(bool);
+
+using namespace ts_native;
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string &what) {
+  if (condition) return;
+  fprintf(stderr, "FAILED: %s\n", what.c_str());
+  failures++;
+}
+
+// One fixed-format line: a sequence number, the indicator, areas A and B
+// padded to column 72 and an identification area.
+std::string line(const char *sequence, char indicator, const std::string &text,
+                 const char *identification) {
+  return std::string(sequence) + indicator + text +
+         std::string(65 - text.size(), ' ') + identification + "\n";
+}
+
+ParseResult parse(const Grammar &grammar, const std::string &source,
+                  bool fixed_format) {
+  ParseOptions options;
+  options.fixed_format = fixed_format;
+  options.include_sexp = true;
+  ParseResult result;
+  parse_source(grammar, options, source.data(),
+               static_cast<uint32_t>(source.size()), &result);
+  return result;
+}
+
+}  // namespace
+
+int main() {
+  const TSLanguage *language = ts_languages_get("COBOL");
+  if (!language) {
+    fprintf(stderr, "COBOL is not built into this test\n");
+    return 1;
+  }
+  Grammar grammar = {
+      "COBOL", language,
+      tree_sitter_COBOL_external_scanner_set_source_areas_stripped,
+      false, nullptr, false, nullptr, false};
+
+  std::string source =
+      line("000100", ' ', "IDENTIFICATION DIVISION.", "FIXED001") +
+      line("000200", ' ', "PROGRAM-ID. FIXED.", "FIXED002") +
+      line("000300", '*', "A COMMENT LINE", "FIXED003") +
+      line("000400", ' ', "PROCEDURE DIVISION.", "FIXED004") +
+      line("000500", ' ', "    STOP RUN.", "FIXED005");
+
+  ParseResult stripped = parse(grammar, source, true);
+  check(stripped.error.empty(), "fixed format: " + stripped.error);
+  check(stripped.error_count == 0,
+        "fixed format: no errors in " + stripped.sexp);
+  check(stripped.comment_lines.size() == 1 &&
+            stripped.comment_lines[0].row == 2,
+        "fixed format: the comment line is listed");
+
+  ParseResult whole = parse(grammar, source, false);
+  check(whole.error.empty(), "whole source: " + whole.error);
+  check(whole.error_count == 0,
+        "whole source after a fixed-format parse: no errors in " + whole.sexp);
+
+  SourceAreas areas;
+  scan_fixed_format(source.data(), static_cast<uint32_t>(source.size()),
+                    &areas);
+  TSParser *parser = ts_parser_new();
+  ts_parser_set_language(parser, language);
+  ts_parser_set_included_ranges(parser, areas.ranges.data(),
+                                static_cast<uint32_t>(areas.ranges.size()));
+  grammar.set_source_areas_stripped(true);
+  TSTree *tree = ts_parser_parse_string(parser, nullptr, source.data(),
+                                        static_cast<uint32_t>(source.size()));
+  grammar.set_source_areas_stripped(false);
+  char *sexp = ts_node_string(ts_tree_root_node(tree));
+  check(stripped.sexp == sexp,
+        std::string("own ranges: the tree parse_source gives, got ") + sexp);
+  free(sexp);
+  ts_tree_delete(tree);
+  ts_parser_delete(parser);
+
+  if (failures == 0) printf("fixed_format_test: all checks passed\n");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,160 @@
+// Flattens the tree of a CoolGen action diagram and walks the live tree
+// beside it: every node's offsets, points, parent, symbol, field and flags
+// must be in its pre-order row. The block then goes through FromBlock, as a
+// cache entry does, and must come back unchanged, while a truncated block
+// or one with another magic number is refused. Exits with 1 when a check
+// fails.
+//
+// Built by CMakeLists.txt (target flat_tree_test) and run by ctest.
+
+#include "batch_parse.h"
+#include "languages.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace ts_native;
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string &what) {
+  if (condition) return;
+  fprintf(stderr, "FAILED: %s\n", what.c_str());
+  failures++;
+}
+
+// Compares row `i` of `flat` with `node`; reports the first difference only.
+bool same_node(const FlatTree &flat, uint32_t i, TSNode node, TSFieldId field,
+               int32_t parent) {
+  using namespace flat_tree;
+  TSPoint start = ts_node_start_point(node);
+  TSPoint end = ts_node_end_point(node);
+  uint8_t flags = (ts_node_is_named(node) ? kFlagNamed : 0) |
+                  (ts_node_is_missing(node) ? kFlagMissing : 0) |
+                  (ts_node_is_extra(node) ? kFlagExtra : 0) |
+                  (ts_node_has_error(node) ? kFlagHasError : 0);
+  return flat.start_bytes()[i] == ts_node_start_byte(node) &&
+         flat.end_bytes()[i] == ts_node_end_byte(node) &&
+         flat.start_rows()[i] == start.row &&
+         flat.start_columns()[i] == start.column &&
+         flat.end_rows()[i] == end.row && flat.end_columns()[i] == end.column &&
+         flat.parents()[i] == parent &&
+         flat.symbols()[i] == ts_node_symbol(node) &&
+         flat.fields()[i] == field && flat.flags()[i] == flags;
+}
+
+// Walks `root` in pre-order next to the rows of `flat`.
+void check_rows(const FlatTree &flat, TSNode root) {
+  std::vector<int32_t> ancestors;
+  TSTreeCursor cursor = ts_tree_cursor_new(root);
+  uint32_t i = 0;
+  for (;;) {
+    if (i >= flat.node_count()) {
+      check(false, "flat tree: fewer rows than nodes");
+      break;
+    }
+    TSNode node = ts_tree_cursor_current_node(&cursor);
+    if (!same_node(flat, i, node, ts_tree_cursor_current_field_id(&cursor),
+                   ancestors.empty() ? -1 : ancestors.back())) {
+      check(false, "flat tree: row " + std::to_string(i) + " is " +
+                       ts_node_type(node) + " at byte " +
+                       std::to_string(ts_node_start_byte(node)));
+      break;
+    }
+    if (ts_tree_cursor_goto_first_child(&cursor)) {
+      ancestors.push_back(i++);
+      continue;
+    }
+    i++;
+    bool done = false;
+    while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+      if (!ts_tree_cursor_goto_parent(&cursor)) {
+        done = true;
+        break;
+      }
+      ancestors.pop_back();
+    }
+    if (done) {
+      check(i == flat.node_count(), "flat tree: as many rows as nodes");
+      break;
+    }
+  }
+  ts_tree_cursor_delete(&cursor);
+}
+
+// A malloc'd copy of the first `size` bytes of `flat`'s block.
+std::shared_ptr<uint8_t> copy_block(const FlatTree &flat, size_t size) {
+  uint8_t *data = static_cast<uint8_t *>(malloc(size));
+  memcpy(data, flat.data(), size);
+  return std::shared_ptr<uint8_t>(data, [](uint8_t *data) { free(data); });
+}
+
+}  // namespace
+
+int main() {
+  const TSLanguage *language = ts_languages_get("coolgen");
+  if (!language) {
+    fprintf(stderr, "coolgen is not built into this test\n");
+    return 1;
+  }
+  Grammar grammar = {"coolgen", language, nullptr, false,
+                     nullptr, false, nullptr, false};
+
+  std::string path = TS_BENCH_ROOT "/tree-sitter-coolgen/test/test.gensrc";
+  std::string source, error;
+  if (!read_file(path, &source, &error)) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+
+  TSParser *parser = thread_parser(language);
+  TSTree *tree = ts_parser_parse_string(parser, nullptr, source.data(),
+                                        static_cast<uint32_t>(source.size()));
+  TSNode root = ts_tree_root_node(tree);
+  FlatTree flat = FlatTree::FromNode(root);
+  check(flat.data() != nullptr, "flat tree: allocated");
+  check(flat.node_count() > 1, "flat tree: nodes below the root");
+  if (flat.data()) check_rows(flat, root);
+  ts_tree_delete(tree);
+
+  ParseOptions options;
+  options.include_flat = true;
+  ParseResult result;
+  parse_source(grammar, options, source.data(),
+               static_cast<uint32_t>(source.size()), &result);
+  check(result.error.empty(), "parse_source: " + result.error);
+  check(result.node_count == flat.node_count(), "parse_source: node count");
+  check(result.flat.size() == flat.size() && flat.data() &&
+            memcmp(result.flat.data(), flat.data(), flat.size()) == 0,
+        "parse_source: the same block");
+
+  if (flat.data()) {
+    FlatTree adopted;
+    check(FlatTree::FromBlock(copy_block(flat, flat.size()), flat.size(),
+                              &adopted),
+          "FromBlock: a whole block");
+    check(adopted.node_count() == flat.node_count() &&
+              adopted.size() == flat.size() &&
+              memcmp(adopted.data(), flat.data(), flat.size()) == 0,
+          "FromBlock: the block unchanged");
+
+    FlatTree truncated;
+    check(!FlatTree::FromBlock(copy_block(flat, flat.size() - 1),
+                               flat.size() - 1, &truncated),
+          "FromBlock: a truncated block is refused");
+
+    std::shared_ptr<uint8_t> other = copy_block(flat, flat.size());
+    other.get()[0] ^= 0xff;
+    FlatTree foreign;
+    check(!FlatTree::FromBlock(other, flat.size(), &foreign),
+          "FromBlock: another magic number is refused");
+  }
+
+  if (failures == 0) printf("flat_tree_test: all checks passed\n");
+  return failures == 0 ? 0 : 1;
+}
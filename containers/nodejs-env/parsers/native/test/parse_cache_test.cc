@@ -0,0 +1,104 @@
+// Parses a CoolGen action diagram through a parse cache in a temporary
+// directory: the first parse stores an entry, the second is served from it
+// with the same counts and flat tree, and a changed source misses it. Exits
+// with 1 when a check fails.
+//
+// Built by CMakeLists.txt (target parse_cache_test) and run by ctest.
+
+#include "batch_parse.h"
+#include "languages.h"
+#include "parse_cache.h"
+
+#include <stdlib.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+using namespace ts_native;
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string &what) {
+  if (condition) return;
+  fprintf(stderr, "FAILED: %s\n", what.c_str());
+  failures++;
+}
+
+ParseResult parse(const Grammar &grammar, const ParseCache *cache,
+                  const std::string &source, bool sexp) {
+  ParseOptions options;
+  options.include_flat = true;
+  options.include_sexp = sexp;
+  options.cache = cache;
+  ParseResult result;
+  parse_source(grammar, options, source.data(),
+               static_cast<uint32_t>(source.size()), &result);
+  return result;
+}
+
+bool same_flat(const FlatTree &a, const FlatTree &b) {
+  return a.data() && b.data() && a.size() == b.size() &&
+         memcmp(a.data(), b.data(), a.size()) == 0;
+}
+
+}  // namespace
+
+int main() {
+  const TSLanguage *language = ts_languages_get("coolgen");
+  if (!language) {
+    fprintf(stderr, "coolgen is not built into this test\n");
+    return 1;
+  }
+  Grammar grammar = {"coolgen", language, nullptr, false,
+                     nullptr, false, nullptr, false};
+
+  std::string path = TS_BENCH_ROOT "/tree-sitter-coolgen/test/test.gensrc";
+  std::string source, error;
+  if (!read_file(path, &source, &error)) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+
+  char directory_template[] = "/tmp/parse_cache_test.XXXXXX";
+  if (!mkdtemp(directory_template)) {
+    perror("mkdtemp");
+    return 1;
+  }
+  const ParseCache *cache = ParseCache::Get(directory_template, language, &error);
+  if (!cache) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  check(ParseCache::Get(directory_template, language, &error) == cache,
+        "the second Get returns the cache opened first");
+
+  ParseResult first = parse(grammar, cache, source, false);
+  check(first.error.empty(), "first parse: " + first.error);
+  check(!first.cached, "first parse: not served from the cache");
+  check(first.flat.data() != nullptr, "first parse: flat tree");
+
+  ParseResult hit = parse(grammar, cache, source, false);
+  check(hit.error.empty(), "second parse: " + hit.error);
+  check(hit.cached, "second parse: served from the cache");
+  check(hit.node_count == first.node_count, "second parse: node count");
+  check(hit.error_count == first.error_count, "second parse: error count");
+  check(same_flat(hit.flat, first.flat), "second parse: same flat tree");
+
+  ParseResult uncovered = parse(grammar, cache, source, true);
+  check(!uncovered.cached, "parse with sexp: not served from the cache");
+  check(!uncovered.sexp.empty(), "parse with sexp: sexp");
+
+  std::string changed = source + "\n";
+  ParseResult miss = parse(grammar, cache, changed, false);
+  check(miss.error.empty(), "changed source: " + miss.error);
+  check(!miss.cached, "changed source: not served from the cache");
+
+  ParseResult changed_hit = parse(grammar, cache, changed, false);
+  check(changed_hit.cached, "changed source again: served from the cache");
+
+  if (failures == 0) printf("parse_cache_test: all checks passed\n");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,234 @@
+// Splits COBOL documents into programs: fixed-format and free-format
+// headers, comment lines and END PROGRAM, with and without fixed_format.
+// Then parses a two-program document through ParseBatch with
+// split_programs and checks that the joined S-expression, flat tree, data
+// flow and query matches are those of the whole document parsed at once,
+// offsets included. Exits with 1 when a check fails.
+//
+// Built by CMakeLists.txt (target program_split_test) and run by ctest.
+
+#include "batch_parse.h"
+#include "languages.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+using namespace ts_native;
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string &what) {
+  if (condition) return;
+  fprintf(stderr, "FAILED: %s\n", what.c_str());
+  failures++;
+}
+
+std::vector<ProgramSpan> programs(const std::string &text, bool fixed_format) {
+  std::vector<ProgramSpan> spans;
+  find_programs(text.data(), static_cast<uint32_t>(text.size()), nullptr,
+                fixed_format, &spans);
+  return spans;
+}
+
+template <typename T>
+bool same(const std::vector<T> &a, const std::vector<T> &b) {
+  return a.size() == b.size() &&
+         (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+}
+
+// Every node but the root, whose extent Join sets to the whole document.
+bool same_nodes(const FlatTree &a, const FlatTree &b) {
+  uint32_t n = a.node_count();
+  if (!a.data() || !b.data() || n != b.node_count() || n == 0) return false;
+  for (uint32_t i = 1; i < n; i++) {
+    if (a.start_bytes()[i] != b.start_bytes()[i] ||
+        a.end_bytes()[i] != b.end_bytes()[i] ||
+        a.start_rows()[i] != b.start_rows()[i] ||
+        a.start_columns()[i] != b.start_columns()[i] ||
+        a.end_rows()[i] != b.end_rows()[i] ||
+        a.end_columns()[i] != b.end_columns()[i] ||
+        a.parents()[i] != b.parents()[i] ||
+        a.symbols()[i] != b.symbols()[i] || a.fields()[i] != b.fields()[i] ||
+        a.flags()[i] != b.flags()[i]) {
+      return false;
+    }
+  }
+  return a.symbols()[0] == b.symbols()[0];
+}
+
+bool same_edges(const DataFlowGraph &a, const DataFlowGraph &b) {
+  if (a.edges.size() != b.edges.size()) return false;
+  for (size_t i = 0; i < a.edges.size(); i++) {
+    const DataFlowEdge &x = a.edges[i];
+    const DataFlowEdge &y = b.edges[i];
+    if (x.token != y.token || x.relation != y.relation ||
+        a.variables[x.variable] != b.variables[y.variable] ||
+        x.source_count != y.source_count) {
+      return false;
+    }
+    for (uint32_t s = 0; s < x.source_count; s++) {
+      if (a.sources[x.first_source + s] != b.sources[y.first_source + s]) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool same_matches(const QueryMatches &a, const QueryMatches &b) {
+  if (a.matches.size() != b.matches.size() || !same(a.captures, b.captures)) {
+    return false;
+  }
+  for (size_t i = 0; i < a.matches.size(); i++) {
+    if (a.matches[i].pattern != b.matches[i].pattern ||
+        a.matches[i].first_capture != b.matches[i].first_capture ||
+        a.matches[i].capture_count != b.matches[i].capture_count) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// The MOVE and ADD operands of the COBOL binding's data flow rules.
+const char *const statements[] = {"move_statement", "add_statement", nullptr};
+const char *const references[] = {"qualified_word", nullptr};
+const char *const subscripts[] = {"subref", "refmod", nullptr};
+const char *const skipped[] = {"comment", "comment_entry", nullptr};
+const DataFlowOperand operands[] = {
+    {"move_statement", "src", OperandRole::kUse, false},
+    {"move_statement", "dst", OperandRole::kDef, false},
+    {"add_statement", "from", OperandRole::kUse, false},
+    {"add_statement", "to", OperandRole::kUseDef, false},
+    {"add_statement", "giving", OperandRole::kDef, false},
+    {nullptr, nullptr, OperandRole::kUse, false},
+};
+const DataFlowRules rules = {statements, references, subscripts, skipped,
+                             operands};
+
+void check_find_programs() {
+  std::string fixed =
+      "000100 IDENTIFICATION DIVISION.\n"
+      "000200 PROGRAM-ID. PROG-A.\n"
+      "000300*IDENTIFICATION DIVISION.\n"
+      "000400 END PROGRAM PROG-A.\n"
+      "000500\n"
+      "000600 identification division.\n"
+      "000700 PROGRAM-ID. PROG-B.\n";
+  size_t second = fixed.find("000500");
+  for (bool fixed_format : {true, false}) {
+    std::string name = fixed_format ? "fixed layout, fixed_format: "
+                                    : "fixed layout, whole lines: ";
+    std::vector<ProgramSpan> spans = programs(fixed, fixed_format);
+    check(spans.size() == 2, name + "two programs");
+    if (spans.size() == 2) {
+      check(spans[0].start_byte == 0 && spans[0].end_byte == second,
+            name + "the first ends after END PROGRAM");
+      check(spans[1].start_byte == second && spans[1].start_row == 4 &&
+                spans[1].end_byte == fixed.size(),
+            name + "the second starts on the line after END PROGRAM");
+    }
+  }
+
+  std::string free =
+      "IDENTIFICATION DIVISION.\n"
+      "PROGRAM-ID. PROG-A.\n"
+      "*> IDENTIFICATION DIVISION.\n"
+      "IDENTIFICATION DIVISION.\n"
+      "PROGRAM-ID. PROG-B.\n"
+      "END PROGRAM PROG-B.\n"
+      "*> trailing comment\n";
+  std::vector<ProgramSpan> spans = programs(free, false);
+  check(spans.size() == 2, "free format: two programs");
+  if (spans.size() == 2) {
+    size_t second = free.find("\nIDENTIFICATION") + 1;
+    check(spans[1].start_byte == second && spans[1].start_row == 3,
+          "free format: the second starts at its header");
+    check(spans[1].end_byte == free.size(),
+          "free format: the last keeps what follows its END PROGRAM");
+  }
+  check(programs(free, true).size() == 1,
+        "free format read as fixed_format: one program");
+}
+
+}  // namespace
+
+int main() {
+  check_find_programs();
+
+  const TSLanguage *language = ts_languages_get("COBOL");
+  if (!language) {
+    fprintf(stderr, "COBOL is not built into this test\n");
+    return 1;
+  }
+  Grammar grammar = {"COBOL", language, nullptr, false,
+                     &rules, true, nullptr, false};
+
+  std::string error;
+  const Query *query = Query::Get(
+      language, "(move_statement src: (_) @src dst: (_) @dst)", &error);
+  if (!query) {
+    fprintf(stderr, "query: %s\n", error.c_str());
+    return 1;
+  }
+
+  std::string source =
+      "       IDENTIFICATION DIVISION.\n"
+      "       PROGRAM-ID. PROG-A.\n"
+      "       PROCEDURE DIVISION.\n"
+      "           MOVE A TO B.\n"
+      "           ADD A TO B GIVING C.\n"
+      "       END PROGRAM PROG-A.\n"
+      "\n"
+      "       IDENTIFICATION DIVISION.\n"
+      "       PROGRAM-ID. PROG-B.\n"
+      "       PROCEDURE DIVISION.\n"
+      "           MOVE X TO Y.\n"
+      "           ADD X TO Y GIVING Z.\n"
+      "       END PROGRAM PROG-B.\n";
+
+  ParseOptions options;
+  options.include_sexp = true;
+  options.include_flat = true;
+  options.data_flow = true;
+  options.query = query;
+  ParseResult whole;
+  parse_source(grammar, options, source.data(),
+               static_cast<uint32_t>(source.size()), &whole);
+  check(whole.error.empty(), "whole document: " + whole.error);
+  check(whole.error_count == 0, "whole document: no errors in " + whole.sexp);
+
+  options.split_programs = true;
+  SourceBuffer buffer = {nullptr, source.data(), source.size()};
+  ParseBatch batch(&grammar, options, std::vector<SourceBuffer>{buffer});
+  batch.run();
+  const ParseResult &split = batch.results()[0];
+  check(split.error.empty(), "split document: " + split.error);
+  check(split.programs.size() == 2, "split document: two programs");
+  if (split.programs.size() == 2) {
+    check(split.programs[1].start_byte == source.find("\n\n") + 1,
+          "split document: the second program starts after END PROGRAM");
+  }
+
+  check(split.sexp == whole.sexp,
+        "sexp: " + split.sexp + "\n  whole: " + whole.sexp);
+  check(split.node_count == whole.node_count, "node count");
+  check(split.error_count == whole.error_count, "error count");
+  check(same_nodes(split.flat, whole.flat), "flat tree nodes and offsets");
+
+  check(same(split.data_flow.tokens, whole.data_flow.tokens),
+        "data flow: tokens and their offsets");
+  check(split.data_flow.variables == whole.data_flow.variables,
+        "data flow: variables");
+  check(same_edges(split.data_flow, whole.data_flow), "data flow: edges");
+  check(!whole.data_flow.edges.empty(), "data flow: some edges");
+
+  check(whole.query_matches.matches.size() == 2, "query: two MOVEs");
+  check(same_matches(split.query_matches, whole.query_matches),
+        "query: matches and capture offsets");
+
+  if (failures == 0) printf("program_split_test: all checks passed\n");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,144 @@
+// Runs queries with text predicates over a small COBOL program and checks
+// which matches Query::Satisfies keeps: #eq? against a string and against
+// another capture, #not-eq?, #any-of?, #match? and #not-match?. The same
+// queries over the program in CP037 compare the decoded text and must keep
+// the same matches at the same offsets. Invalid predicates are refused by
+// Query::Get. Exits with 1 when a check fails.
+//
+// Built by CMakeLists.txt (target query_test) and run by ctest.
+
+#include "batch_parse.h"
+#include "languages.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace ts_native;
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string &what) {
+  if (condition) return;
+  fprintf(stderr, "FAILED: %s\n", what.c_str());
+  failures++;
+}
+
+// `text` in `code_page`; every character of it has to be in the code page.
+std::string encode(const std::string &text, const CodePage &code_page) {
+  std::string out;
+  for (unsigned char c : text) {
+    for (uint32_t byte = 0; byte < 256; byte++) {
+      if (code_page.to_unicode[byte] == c) {
+        out += static_cast<char>(byte);
+        break;
+      }
+    }
+  }
+  return out;
+}
+
+QueryMatches run(const Grammar &grammar, const Query *query,
+                 const std::string &source, const CodePage *code_page) {
+  ParseOptions options;
+  options.query = query;
+  options.code_page = code_page;
+  ParseResult result;
+  parse_source(grammar, options, source.data(),
+               static_cast<uint32_t>(source.size()), &result);
+  check(result.error.empty(), "parse: " + result.error);
+  return result.query_matches;
+}
+
+// The captured text of each match, its captures joined by spaces.
+std::vector<std::string> texts(const QueryMatches &matches,
+                               const std::string &source) {
+  std::vector<std::string> out;
+  for (const QueryMatch &match : matches.matches) {
+    std::string text;
+    for (uint32_t i = 0; i < match.capture_count; i++) {
+      const QueryCapture &capture = matches.captures[match.first_capture + i];
+      if (i > 0) text += ' ';
+      text += source.substr(capture.start_byte,
+                            capture.end_byte - capture.start_byte);
+    }
+    out.push_back(text);
+  }
+  return out;
+}
+
+struct Case {
+  const char *query;
+  std::vector<std::string> matches;
+};
+
+}  // namespace
+
+int main() {
+  const TSLanguage *language = ts_languages_get("COBOL");
+  const CodePage *cp037 = find_code_page("cp037");
+  if (!language || !cp037) {
+    fprintf(stderr, "COBOL or cp037 is not built into this test\n");
+    return 1;
+  }
+  Grammar grammar = {"COBOL", language, nullptr, false,
+                     nullptr, false, nullptr, false};
+
+  std::string source =
+      "       IDENTIFICATION DIVISION.\n"
+      "       PROGRAM-ID. PRED.\n"
+      "       PROCEDURE DIVISION.\n"
+      "           MOVE A TO B.\n"
+      "           MOVE C TO C.\n"
+      "           MOVE X TO Y.\n";
+  std::string ebcdic = encode(source, *cp037);
+
+  std::vector<Case> cases = {
+      {"((program_name) @name (#eq? @name \"PRED\"))", {"PRED"}},
+      {"((program_name) @name (#eq? @name \"OTHER\"))", {}},
+      {"((program_name) @name (#not-eq? @name \"OTHER\"))", {"PRED"}},
+      {"(move_statement src: (_) @src dst: (_) @dst (#eq? @src @dst))",
+       {"C C"}},
+      {"(move_statement dst: (_) @dst (#any-of? @dst \"B\" \"Y\"))",
+       {"B", "Y"}},
+      {"(move_statement src: (_) @src (#match? @src \"^[AC]$\"))",
+       {"A", "C"}},
+      {"(move_statement src: (_) @src (#not-match? @src \"^[AC]$\"))",
+       {"X"}},
+  };
+  for (const Case &test : cases) {
+    std::string error;
+    const Query *query = Query::Get(language, test.query, &error);
+    check(query != nullptr, std::string(test.query) + ": " + error);
+    if (!query) continue;
+
+    QueryMatches utf8 = run(grammar, query, source, nullptr);
+    check(texts(utf8, source) == test.matches,
+          std::string(test.query) + ": " +
+              std::to_string(test.matches.size()) + " matches, got " +
+              std::to_string(utf8.matches.size()));
+
+    QueryMatches decoded = run(grammar, query, ebcdic, cp037);
+    check(decoded.matches.size() == utf8.matches.size() &&
+              decoded.captures.size() == utf8.captures.size() &&
+              (utf8.captures.empty() ||
+               memcmp(decoded.captures.data(), utf8.captures.data(),
+                      utf8.captures.size() * sizeof(QueryCapture)) == 0),
+          std::string(test.query) + ": the same matches in cp037");
+  }
+
+  for (const char *invalid :
+       {"((program_name) @name (#match? @name \"[\"))",
+        "((program_name) @name (#eq? @name))",
+        "((program_name) @name (#frobnicate? @name))"}) {
+    std::string error;
+    check(Query::Get(language, invalid, &error) == nullptr && !error.empty(),
+          std::string(invalid) + ": refused");
+  }
+
+  if (failures == 0) printf("query_test: all checks passed\n");
+  return failures == 0 ? 0 : 1;
+}
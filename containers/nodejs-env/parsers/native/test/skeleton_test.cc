@@ -0,0 +1,183 @@
+// Extracts the skeleton of a fixed-format COBOL program: divisions, the
+// program name, a section, a paragraph, COPY, CALL with a literal and with
+// an identifier, END PROGRAM and a Tandem ?SEARCH directive, with comment
+// lines ignored. The same program in CP037 must give the same landmarks at
+// the same offsets. Then the skeleton of a CoolGen module: its name, date
+// and time, the views of each header block and the USE statements of
+// numbered lines. Exits with 1 when a check fails.
+//
+// Built by CMakeLists.txt (target skeleton_test) and run by ctest.
+
+#include "skeleton.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace ts_native;
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string &what) {
+  if (condition) return;
+  fprintf(stderr, "FAILED: %s\n", what.c_str());
+  failures++;
+}
+
+struct Expected {
+  LandmarkKind kind;
+  uint32_t row;
+  const char *name;
+  // The text from the landmark's start to its end.
+  const char *text;
+};
+
+// `text` in `code_page`; every character of it has to be in the code page.
+std::string encode(const std::string &text, const CodePage &code_page) {
+  std::string out;
+  for (unsigned char c : text) {
+    for (uint32_t byte = 0; byte < 256; byte++) {
+      if (code_page.to_unicode[byte] == c) {
+        out += static_cast<char>(byte);
+        break;
+      }
+    }
+  }
+  return out;
+}
+
+void check_landmarks(const std::string &name, const std::string &text,
+                     const std::vector<Landmark> &landmarks,
+                     const std::vector<Expected> &expected) {
+  check(landmarks.size() == expected.size(),
+        name + ": " + std::to_string(expected.size()) + " landmarks, got " +
+            std::to_string(landmarks.size()));
+  for (size_t i = 0; i < landmarks.size() && i < expected.size(); i++) {
+    const Landmark &landmark = landmarks[i];
+    std::string what = name + ": landmark " + std::to_string(i) + " (" +
+                       expected[i].name + ")";
+    check(landmark.kind == expected[i].kind, what + " kind");
+    check(landmark.row == expected[i].row, what + " row");
+    check(text.substr(landmark.name_start,
+                      landmark.name_end - landmark.name_start) ==
+              expected[i].name,
+          what + " name");
+    check(text.substr(landmark.start_byte,
+                      landmark.end_byte - landmark.start_byte) ==
+              expected[i].text,
+          what + " extent");
+  }
+}
+
+void check_cobol() {
+  std::string source =
+      "000100 IDENTIFICATION DIVISION.\n"
+      "000200 PROGRAM-ID. SKEL.\n"
+      "000300?SEARCH ($VOL.SUB.OBJA, $VOL.SUB.OBJB)\n"
+      "000400 ENVIRONMENT DIVISION.\n"
+      "000500 DATA DIVISION.\n"
+      "000600 WORKING-STORAGE SECTION.\n"
+      "000700     COPY CUSTREC.\n"
+      "000800*    COPY COMMENTED.\n"
+      "000900 PROCEDURE DIVISION.\n"
+      "001000 MAIN-PARA.\n"
+      "001100     CALL \"SUBPROG\" USING X.\n"
+      "001200     CALL DYNAMIC-NAME.\n"
+      "001300 END PROGRAM SKEL.\n";
+  std::vector<Expected> expected = {
+      {kLandmarkDivision, 0, "IDENTIFICATION", "IDENTIFICATION DIVISION"},
+      {kLandmarkProgram, 1, "SKEL", "PROGRAM-ID. SKEL"},
+      {kLandmarkSearch, 2, "$VOL.SUB.OBJA",
+       "?SEARCH ($VOL.SUB.OBJA, $VOL.SUB.OBJB)"},
+      {kLandmarkSearch, 2, "$VOL.SUB.OBJB",
+       "?SEARCH ($VOL.SUB.OBJA, $VOL.SUB.OBJB)"},
+      {kLandmarkDivision, 3, "ENVIRONMENT", "ENVIRONMENT DIVISION"},
+      {kLandmarkDivision, 4, "DATA", "DATA DIVISION"},
+      {kLandmarkSection, 5, "WORKING-STORAGE", "WORKING-STORAGE SECTION"},
+      {kLandmarkCopy, 6, "CUSTREC", "COPY CUSTREC"},
+      {kLandmarkDivision, 8, "PROCEDURE", "PROCEDURE DIVISION"},
+      {kLandmarkParagraph, 9, "MAIN-PARA", "MAIN-PARA."},
+      {kLandmarkCall, 10, "SUBPROG", "CALL \"SUBPROG\""},
+      {kLandmarkCall, 11, "DYNAMIC-NAME", "CALL DYNAMIC-NAME"},
+      {kLandmarkEndProgram, 12, "SKEL", "END PROGRAM SKEL"},
+  };
+
+  std::vector<Landmark> landmarks;
+  extract_cobol_skeleton(source.data(), static_cast<uint32_t>(source.size()),
+                         nullptr, &landmarks);
+  check_landmarks("cobol", source, landmarks, expected);
+
+  const CodePage *cp037 = find_code_page("cp037");
+  check(cp037 != nullptr, "cp037 found");
+  if (!cp037) return;
+  std::string ebcdic = encode(source, *cp037);
+  check(ebcdic.size() == source.size(), "cobol cp037: encoded");
+  std::vector<Landmark> decoded;
+  extract_cobol_skeleton(ebcdic.data(), static_cast<uint32_t>(ebcdic.size()),
+                         cp037, &decoded);
+  bool same = decoded.size() == landmarks.size();
+  for (size_t i = 0; same && i < decoded.size(); i++) {
+    same = decoded[i].kind == landmarks[i].kind &&
+           decoded[i].start_byte == landmarks[i].start_byte &&
+           decoded[i].end_byte == landmarks[i].end_byte &&
+           decoded[i].row == landmarks[i].row &&
+           decoded[i].name_start == landmarks[i].name_start &&
+           decoded[i].name_end == landmarks[i].name_end;
+  }
+  check(same, "cobol cp037: the landmarks of the UTF-8 source");
+}
+
+void check_coolgen() {
+  std::string source =
+      "       +->   DYYY0111_PARENT_CREATE            07/05/2023  15:08\n"
+      "       !       IMPORTS:\n"
+      "       !         Work View imp_error iyy1_component (Transient, Import only)\n"
+      "       !           severity_code\n"
+      "       !         Entity View imp parent (Transient, Import only)\n"
+      "       !       EXPORTS:\n"
+      "       !         Group View (30) exp_group\n"
+      "       !       ENTITY ACTIONS:\n"
+      "       !         Entity View parent\n"
+      "       !       LOCALS:\n"
+      "       !         Work View loc dont_change_return_codes\n"
+      "       !\n"
+      "       !     PROCEDURE STATEMENTS\n"
+      "       !\n"
+      "     1 !  NOTE:\n"
+      "    27 !  USE isc1z021_o_authorization_check_s\n"
+      "    28 !  !  USE cyyy9831_mv_sc1_to_yy1\n"
+      "       !  USE not_a_statement\n";
+  std::vector<Expected> expected = {
+      {kLandmarkProgram, 0, "DYYY0111_PARENT_CREATE",
+       "+->   DYYY0111_PARENT_CREATE"},
+      {kLandmarkDate, 0, "07/05/2023", "07/05/2023"},
+      {kLandmarkTime, 0, "15:08", "15:08"},
+      {kLandmarkImportView, 2, "imp_error", "Work View imp_error"},
+      {kLandmarkImportView, 4, "imp", "Entity View imp"},
+      {kLandmarkExportView, 6, "exp_group", "Group View (30) exp_group"},
+      {kLandmarkEntityActionView, 8, "parent", "Entity View parent"},
+      {kLandmarkLocalView, 10, "loc", "Work View loc"},
+      {kLandmarkUse, 15, "isc1z021_o_authorization_check_s",
+       "USE isc1z021_o_authorization_check_s"},
+      {kLandmarkUse, 16, "cyyy9831_mv_sc1_to_yy1",
+       "USE cyyy9831_mv_sc1_to_yy1"},
+  };
+
+  std::vector<Landmark> landmarks;
+  extract_coolgen_skeleton(source.data(),
+                           static_cast<uint32_t>(source.size()), nullptr,
+                           &landmarks);
+  check_landmarks("coolgen", source, landmarks, expected);
+}
+
+}  // namespace
+
+int main() {
+  check_cobol();
+  check_coolgen();
+
+  if (failures == 0) printf("skeleton_test: all checks passed\n");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,99 @@
+// Splits fixed-format lines into their source areas: a UTF-8 literal whose
+// multibyte characters come before column 73, multibyte characters in the
+// sequence area, and the same columns in CP037, where every character is
+// one byte. Exits with 1 when a check fails.
+//
+// Built by CMakeLists.txt (target source_areas_test) and run by ctest.
+
+#include "source_areas.h"
+
+#include <cstdio>
+#include <string>
+
+using namespace ts_native;
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string &what) {
+  if (condition) return;
+  fprintf(stderr, "FAILED: %s\n", what.c_str());
+  failures++;
+}
+
+std::string range_text(const std::string &text, const TSRange &range) {
+  return text.substr(range.start_byte, range.end_byte - range.start_byte);
+}
+
+}  // namespace
+
+int main() {
+  // Columns 8-72 hold 65 characters, five of them two bytes long in UTF-8:
+  // the literal is "Łódź été".
+  std::string literal = "DISPLAY \"\xC5\x81\xC3\xB3\x64\xC5\xBA \xC3\xA9t\xC3\xA9\"";
+  std::string area_b = "    " + literal;
+  std::string padding(65 - (area_b.size() - 5), ' ');
+  std::string utf8 =
+      "000100 IDENTIFICATION DIVISION.\n"
+      "000200" " " + area_b + padding + "SEQ00002\n"
+      "\xC3\x84" "B0100* comment after a two-byte sequence number\n";
+  SourceAreas areas;
+  scan_fixed_format(utf8.data(), static_cast<uint32_t>(utf8.size()), &areas);
+
+  check(areas.ranges.size() == 3, "utf-8: three ranges");
+  if (areas.ranges.size() == 3) {
+    const TSRange &literal_line = areas.ranges[1];
+    check(range_text(utf8, literal_line) == area_b + padding,
+          "utf-8: area A and B end at the 72nd character, got '" +
+              range_text(utf8, literal_line) + "'");
+    check(literal_line.start_point.row == 1 &&
+              literal_line.start_point.column == 7,
+          "utf-8: area A starts at byte 7");
+    check(literal_line.end_point.column == 7 + area_b.size() + padding.size(),
+          "utf-8: area B end point in bytes");
+    check(range_text(utf8, areas.ranges[2]) == "\n",
+          "utf-8: the identification area is left out");
+  }
+  check(areas.comments.size() == 1 && areas.comments[0].row == 2 &&
+            areas.comments[0].indicator == '*',
+        "utf-8: indicator found after a two-byte sequence area");
+
+  // The same columns in CP037: '*' is 0x5C, the blank 0x40, LF 0x25 and
+  // 'A' 0xC1.
+  const CodePage *cp037 = find_code_page("cp037");
+  check(cp037 != nullptr, "cp037 found");
+  if (cp037) {
+    std::string ebcdic(6, '\xF0');
+    ebcdic += '\x40';
+    ebcdic += std::string(65, '\xC1');
+    ebcdic += std::string(8, '\xF9');
+    ebcdic += '\x25';
+    ebcdic += std::string(6, '\xF0');
+    ebcdic += '\x5C';
+    ebcdic += '\x25';
+    scan_fixed_format(ebcdic.data(), static_cast<uint32_t>(ebcdic.size()),
+                      &areas, cp037);
+    check(areas.ranges.size() == 2, "cp037: two ranges");
+    if (areas.ranges.size() == 2) {
+      check(areas.ranges[0].start_byte == 7 && areas.ranges[0].end_byte == 72,
+            "cp037: area A and B are bytes 7 to 72");
+      check(areas.ranges[1].start_byte == 80 && areas.ranges[1].end_byte == 81,
+            "cp037: then the newline");
+    }
+    check(areas.comments.size() == 1 && areas.comments[0].indicator == '*',
+          "cp037: comment line");
+  }
+
+  // Lines that end inside the sequence area or at the indicator.
+  std::string short_lines = "\xC3\xA9\xC3\xA9\n000100\n000200-\n";
+  scan_fixed_format(short_lines.data(),
+                    static_cast<uint32_t>(short_lines.size()), &areas);
+  check(areas.comments.empty(), "short lines: no comments");
+  check(areas.ranges.size() == 1 &&
+            range_text(short_lines, areas.ranges[0]) == "-\n",
+        "short lines: only the continuation indicator and its newline");
+
+  if (failures == 0) printf("source_areas_test: all checks passed\n");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,258 @@
+// Runs the NIST COBOL85 suite in one process, the native counterpart of
+// run_nist_cobol85.sh:
+//
+//   nist_cobol85 [--jobs N] [--trees] [DIR]
+//
+// DIR is the tree-sitter-cobol checkout (by default the one next to this
+// file's tree). Every test/cobol85/src/*.CBL not listed in skip_tests.txt is
+// memory-mapped and parsed on N threads (all cores by default), each with
+// its own reused parser. test/cobol85/summary.txt gets the script's
+// "NAME.CBL OK" / "NAME.CBL <NG>" lines and totals, and
+// test/cobol85/timings.tsv the parse time, node, ERROR and MISSING counts of
+// every file. --trees also writes each S-expression to test/cobol85/result/,
+// as the script does.
+//
+// A program is OK when its tree has no ERROR or MISSING node, which is when
+// `tree-sitter parse` exits with 0. The exit status is 1 if any is <NG>.
+//
+// Built by CMakeLists.txt (target nist_cobol85), like corpus_bench.
+
+#include "batch_parse.h"
+#include "languages.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ts_native;
+
+namespace {
+
+struct TestCase {
+  std::string name;
+  std::string path;
+  bool skipped = false;
+  // Index into the batch, for the cases that are parsed.
+  size_t job = 0;
+};
+
+bool ends_with(const std::string &text, const char *suffix) {
+  size_t n = strlen(suffix);
+  return text.size() >= n && text.compare(text.size() - n, n, suffix) == 0;
+}
+
+std::vector<std::string> read_lines(const std::string &path) {
+  std::vector<std::string> lines;
+  std::ifstream file(path);
+  std::string line;
+  while (std::getline(file, line)) {
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+// The script skips a program when its name occurs anywhere in the file,
+// `grep NAME skip_tests.txt`; so does this.
+bool is_skipped(const std::vector<std::string> &skip_lines,
+                const std::string &name) {
+  for (const std::string &line : skip_lines) {
+    if (line.find(name) != std::string::npos) return true;
+  }
+  return false;
+}
+
+// Maps `path` read-only. The mapping is released with the last copy of the
+// buffer's owner.
+bool map_file(const std::string &path, SourceBuffer *buffer,
+              std::string *error) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    *error = "cannot open " + path + ": " + strerror(errno);
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    *error = "cannot stat " + path + ": " + strerror(errno);
+    close(fd);
+    return false;
+  }
+  size_t length = static_cast<size_t>(st.st_size);
+  buffer->length = length;
+  buffer->data = "";
+  if (length > 0) {
+    void *data = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      *error = "cannot map " + path + ": " + strerror(errno);
+      close(fd);
+      return false;
+    }
+    // Every page is read, and soon.
+    madvise(data, length, MADV_WILLNEED);
+    buffer->owner.reset(data, [length](void *p) { munmap(p, length); });
+    buffer->data = static_cast<const char *>(data);
+  }
+  close(fd);
+  return true;
+}
+
+void usage() {
+  fprintf(stderr, "usage: nist_cobol85 [--jobs N] [--trees] [DIR]\n");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+  bool trees = false;
+  std::string root = std::string(TS_BENCH_ROOT) + "/tree-sitter-cobol-main";
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+      jobs = std::max(1, atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--trees") == 0) {
+      trees = true;
+    } else if (argv[i][0] != '-') {
+      root = argv[i];
+    } else {
+      usage();
+      return 2;
+    }
+  }
+
+  const TSLanguage *language = ts_languages_get("COBOL");
+  if (!language) {
+    fprintf(stderr, "COBOL is not built into this runner\n");
+    return 2;
+  }
+  Grammar grammar = {"COBOL", language, nullptr, false, nullptr, false,
+                     nullptr, false};
+
+  const std::string source_dir = root + "/test/cobol85/src";
+  const std::string result_dir = root + "/test/cobol85/result";
+  std::vector<TestCase> cases;
+  if (DIR *dir = opendir(source_dir.c_str())) {
+    while (struct dirent *entry = readdir(dir)) {
+      std::string file_name = entry->d_name;
+      if (!ends_with(file_name, ".CBL")) continue;
+      TestCase test;
+      test.name = file_name;
+      test.path = source_dir + "/" + file_name;
+      cases.push_back(test);
+    }
+    closedir(dir);
+  }
+  if (cases.empty()) {
+    fprintf(stderr, "%s: no .CBL files\n", source_dir.c_str());
+    return 2;
+  }
+  std::sort(cases.begin(), cases.end(),
+            [](const TestCase &a, const TestCase &b) { return a.name < b.name; });
+
+  std::vector<std::string> skip_lines = read_lines(root + "/skip_tests.txt");
+  std::vector<SourceBuffer> buffers;
+  std::vector<TestCase *> parsed;
+  for (TestCase &test : cases) {
+    std::string body = test.name.substr(0, test.name.size() - 4);
+    if (is_skipped(skip_lines, body)) {
+      test.skipped = true;
+      continue;
+    }
+    SourceBuffer buffer;
+    std::string error;
+    if (!map_file(test.path, &buffer, &error)) {
+      fprintf(stderr, "%s\n", error.c_str());
+      return 2;
+    }
+    parsed.push_back(&test);
+    buffers.push_back(std::move(buffer));
+  }
+
+  // Largest programs first, so the last files claimed are the short ones
+  // and no thread is left finishing a long parse alone.
+  std::vector<size_t> order(buffers.size());
+  for (size_t i = 0; i < order.size(); i++) order[i] = i;
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return buffers[a].length > buffers[b].length;
+  });
+  std::vector<SourceBuffer> queue;
+  queue.reserve(order.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    parsed[order[i]]->job = i;
+    queue.push_back(buffers[order[i]]);
+  }
+  buffers.clear();
+
+  ParseOptions options;
+  options.include_sexp = trees;
+  ParseBatch batch(&grammar, options, std::move(queue));
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (unsigned i = 1; i < jobs; i++) {
+    workers.emplace_back([&batch] { batch.run(); });
+  }
+  batch.run();
+  for (std::thread &worker : workers) worker.join();
+  double wall_ms = std::chrono::duration<double, std::milli>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+
+  if (trees) mkdir(result_dir.c_str(), 0777);
+  FILE *summary = fopen((root + "/test/cobol85/summary.txt").c_str(), "w");
+  FILE *timings = fopen((root + "/test/cobol85/timings.tsv").c_str(), "w");
+  if (!summary || !timings) {
+    fprintf(stderr, "cannot write to %s/test/cobol85\n", root.c_str());
+    return 2;
+  }
+  fprintf(timings, "file\tbytes\tparse_ms\tnodes\terrors\tmissing\n");
+
+  size_t success = 0, fail = 0, skip = 0;
+  double parse_ms = 0;
+  for (const TestCase &test : cases) {
+    if (test.skipped) {
+      skip++;
+      continue;
+    }
+    const ParseResult &result = batch.results()[test.job];
+    bool ok = result.error.empty() && result.error_count == 0 &&
+              result.missing_count == 0;
+    const char *line_format = ok ? "%s OK\n" : "%s <NG>\n";
+    printf(line_format, test.name.c_str());
+    fprintf(summary, line_format, test.name.c_str());
+    (ok ? success : fail)++;
+    parse_ms += result.parse_ms;
+
+    fprintf(timings, "%s\t%u\t%.4f\t%u\t%u\t%u\n", test.name.c_str(),
+            result.bytes, result.parse_ms, result.node_count,
+            result.error_count, result.missing_count);
+    if (trees) {
+      std::string body = test.name.substr(0, test.name.size() - 4);
+      std::ofstream((result_dir + "/" + body + ".txt").c_str())
+          << result.sexp << '\n';
+    }
+  }
+
+  char totals[128];
+  snprintf(totals, sizeof(totals),
+           "%zu tests. (Success: %zu, Fail: %zu, Skip: %zu)\n", cases.size(),
+           success, fail, skip);
+  fputs(totals, stdout);
+  fputs(totals, summary);
+  fclose(summary);
+  fclose(timings);
+  fprintf(stderr, "%.1f ms wall, %.1f ms parsing on %u threads\n", wall_ms,
+          parse_ms, jobs);
+  return fail == 0 ? 0 : 1;
+}
@@ -0,0 +1,147 @@
+#!/bin/bash
+# Profile-guided optimized builds of both Node addons and my-languages.so.
+#
+#   ./pgo.sh
+#
+# Measures a plain build, builds everything instrumented, trains on
+# tree-sitter-cobol-main/test/cobol85/src, tree-sitter-cobol-main/test/custom/src
+# and tree-sitter-coolgen/test/yyy, rebuilds with the profiles and measures
+# again. The before/after throughput goes to pgo-report.txt, or the list of
+# prerequisites that are missing. The generated ts_lex/ts_lex_keywords
+# switches are where most of the gain comes from.
+#
+# Needs node-gyp (NODE_GYP, default "npx node-gyp"), cmake and, for the
+# shared library, python3 with the tree_sitter package.
+set -euo pipefail
+
+cd "$(dirname "$0")"
+ROOT=$(pwd)
+COBOL=$ROOT/tree-sitter-cobol-main
+COOLGEN=$ROOT/tree-sitter-coolgen
+PROFILE_DIR=$ROOT/build/pgo
+REPORT=$ROOT/pgo-report.txt
+NODE_GYP=${NODE_GYP:-npx node-gyp}
+ROUNDS=${ROUNDS:-5}
+
+build() {
+  local mode=$1
+  for dir in "$COBOL" "$COOLGEN"; do
+    (cd "$dir" && $NODE_GYP rebuild -- -Dpgo="$mode" \
+      -Dpgo_dir="$PROFILE_DIR/$(basename "$dir")") > /dev/null
+  done
+  cmake -S "$ROOT" -B "$ROOT/build" -DTS_LANGUAGES_PGO="$mode" \
+    -DTS_LANGUAGES_PGO_DIR="$PROFILE_DIR/library" > /dev/null
+  cmake --build "$ROOT/build" -j"$(nproc)" > /dev/null
+  cp "$ROOT/build/my-languages.so" "$ROOT/my-languages.so"
+}
+
+# Parses every corpus through my-languages.so and prints MB/s per language.
+library_bench() {
+  python3 - "$ROOT" "$1" <<'EOF'
+import glob, os, sys, time
+sys.path.insert(0, sys.argv[1])
+from languages import language
+from tree_sitter import Parser
+
+root, rounds = sys.argv[1], int(sys.argv[2])
+corpora = [
+    ('COBOL', 'tree-sitter-cobol-main/test/cobol85/src/*'),
+    ('COBOL', 'tree-sitter-cobol-main/test/custom/src/*'),
+    ('coolgen', 'tree-sitter-coolgen/test/yyy/*.gensrc'),
+]
+for name, pattern in corpora:
+    try:
+        parser = Parser(language(name))
+    except TypeError:  # py-tree-sitter 0.21
+        parser = Parser()
+        parser.set_language(language(name))
+    sources = [open(path, 'rb').read()
+               for path in sorted(glob.glob(os.path.join(root, pattern)))]
+    size = sum(map(len, sources)) * rounds
+    start = time.perf_counter()
+    for _ in range(rounds):
+        for source in sources:
+            parser.parse(source)
+    seconds = time.perf_counter() - start
+    print('%-48s %8.2f MB/s' % ('my-languages.so ' + pattern, size / seconds / 1e6))
+EOF
+}
+
+measure() {
+  local rounds=$1
+  for corpus in test/cobol85/src test/custom/src; do
+    printf '%-48s %s\n' "COBOL addon $corpus" \
+      "$(cd "$COBOL" && node bench/throughput.js "$corpus" "$rounds" | tail -1)"
+  done
+  printf '%-48s %s\n' "CoolGen addon test/yyy" \
+    "$(cd "$COOLGEN" && node bench/throughput.js test/yyy "$rounds" | tail -1)"
+  library_bench "$rounds"
+}
+
+# The training run exercises both the plain and the fixed-format COBOL paths.
+train() {
+  (cd "$COBOL" && node -e '
+    const fs = require("fs");
+    const COBOL = require(".");
+    const files = ["test/cobol85/src", "test/custom/src"].flatMap((dir) =>
+      fs.readdirSync(dir).map((name) => `${dir}/${name}`));
+    (async () => {
+      for (const fixedFormat of [false, true]) {
+        await COBOL.parseFiles(files, { concurrency: 1, fixedFormat });
+      }
+    })();')
+  (cd "$COOLGEN" && node bench/throughput.js test/yyy 1 > /dev/null)
+  library_bench 1 > /dev/null
+
+  # Clang writes raw profiles that have to be merged before they can be used.
+  for dir in "$PROFILE_DIR"/*/; do
+    if ls "$dir"*.profraw > /dev/null 2>&1; then
+      llvm-profdata merge -o "$dir/default.profdata" "$dir"*.profraw
+    fi
+  done
+}
+
+# Everything a measurement needs, checked before the first build. Without it
+# the report says what is missing instead of holding no numbers at all.
+missing=()
+for dir in "$COBOL" "$COOLGEN"; do
+  if ! (cd "$dir" && node -e 'require.resolve("tree-sitter/package.json")') 2> /dev/null; then
+    missing+=("the tree-sitter npm package in $(basename "$dir") (npm install)")
+  fi
+done
+if [ ! -f "$COBOL/src/parser.c" ] && ! command -v tree-sitter > /dev/null; then
+  missing+=("tree-sitter-cobol-main/src/parser.c, or the tree-sitter CLI to generate it")
+fi
+if ! python3 -c 'import tree_sitter' 2> /dev/null; then
+  missing+=("the tree_sitter Python package")
+fi
+if [ ${#missing[@]} -gt 0 ]; then
+  {
+    echo "PGO not measured ($(date -u +%Y-%m-%d)). Missing:"
+    printf '  %s\n' "${missing[@]}"
+  } | tee "$REPORT" >&2
+  exit 2
+fi
+
+echo "Plain build..."
+build ""
+before=$(measure "$ROUNDS")
+
+echo "Instrumented build and training run..."
+rm -rf "$PROFILE_DIR"
+build generate
+train
+
+echo "Optimized build..."
+build use
+after=$(measure "$ROUNDS")
+
+{
+  echo "PGO throughput, $ROUNDS rounds, single thread ($(date -u +%Y-%m-%d))"
+  echo
+  echo "Before:"
+  echo "$before"
+  echo
+  echo "After:"
+  echo "$after"
+} | tee "$REPORT"
@@ -0,0 +1,39 @@
+// Parses every file of a directory a few times through the native batch API
+// and prints bytes/s. Run it before and after a scanner or grammar change:
+//
+//   node bench/throughput.js [dir] [rounds]
+//
+// Defaults to test/cobol85/src and 5 rounds, on a single thread so the number
+// tracks the parser itself rather than the core count.
+const fs = require("fs");
+const path = require("path");
+const COBOL = require("..");
+
+const dir = process.argv[2] || path.join(__dirname, "..", "test", "cobol85", "src");
+const rounds = Number(process.argv[3]) || 5;
+
+async function main() {
+  const files = fs.readdirSync(dir)
+    .filter((name) => fs.statSync(path.join(dir, name)).isFile())
+    .sort()
+    .map((name) => path.join(dir, name));
+
+  let bytes = 0;
+  let seconds = 0;
+  for (let round = 0; round < rounds; round++) {
+    const results = await COBOL.parseFiles(files, { concurrency: 1 });
+    for (const result of results) {
+      if (result.error) throw new Error(`${result.path}: ${result.error}`);
+      bytes += result.bytes;
+      seconds += result.parseTime / 1000;
+    }
+  }
+
+  console.log(`${files.length} files x ${rounds} rounds`);
+  console.log(`${(bytes / seconds / 1e6).toFixed(2)} MB/s`);
+}
+
+main().catch((error) => {
+  console.error(error);
+  process.exit(1);
+});
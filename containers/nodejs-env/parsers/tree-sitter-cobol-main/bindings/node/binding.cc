@@ -1,28 +1,106 @@
 #include "tree_sitter/parser.h"
 #include <node.h>
 #include "nan.h"
+#include "native_binding.h"
+#include "data_flow.h"
+#include "skeleton.h"
 
 using namespace v8;
 
 extern "C" TSLanguage * tree_sitter_COBOL();
+extern "C" void tree_sitter_COBOL_external_scanner_set_source_areas_stripped(bool);
 
 namespace {
 
+using ts_native::OperandRole;
+
+const char *const data_flow_statements[] = {
+  "move_statement", "compute_statement", "add_statement",
+  "subtract_statement", "multiply_statement", "divide_statement",
+  "initialize_statement", "string_statement", "unstring_statement",
+  "set_statement", "read_statement", "return_statement", nullptr,
+};
+const char *const data_flow_references[] = {"qualified_word", nullptr};
+const char *const data_flow_subscripts[] = {"subref", "refmod", nullptr};
+const char *const data_flow_skipped[] = {"comment", "comment_entry", nullptr};
+
+const ts_native::DataFlowOperand data_flow_operands[] = {
+  {"move_statement", "src", OperandRole::kUse, false},
+  {"move_statement", "dst", OperandRole::kDef, false},
+  {"compute_statement", "right", OperandRole::kUse, false},
+  {"compute_statement", "left", OperandRole::kDef, false},
+  {"add_statement", "from", OperandRole::kUse, false},
+  {"add_statement", "to", OperandRole::kUseDef, false},
+  {"add_statement", "giving", OperandRole::kDef, false},
+  {"subtract_statement", "x", OperandRole::kUse, false},
+  {"subtract_statement", "from", OperandRole::kUseDef, false},
+  {"subtract_statement", "giving", OperandRole::kDef, false},
+  {"multiply_statement", "val1", OperandRole::kUse, false},
+  {"multiply_statement", "val2", OperandRole::kUseDef, false},
+  {"multiply_statement", "giving", OperandRole::kDef, false},
+  {"divide_statement", "x", OperandRole::kUse, false},
+  {"divide_statement", "into", OperandRole::kUseDef, false},
+  {"divide_statement", "by", OperandRole::kUse, false},
+  {"divide_statement", "giving", OperandRole::kDef, false},
+  {"divide_statement", "remainder", OperandRole::kDef, false},
+  {"initialize_statement", "x", OperandRole::kDef, false},
+  {"string_statement", "from", OperandRole::kUse, false},
+  {"string_statement", "into", OperandRole::kDef, false},
+  {"unstring_statement", "x", OperandRole::kUse, false},
+  {"unstring_into_item", "x", OperandRole::kDef, false},
+  {"unstring_into_item", "delimiter", OperandRole::kDef, false},
+  {"unstring_into_item", "count", OperandRole::kDef, false},
+  {"set_to", "from", OperandRole::kDef, false},
+  {"set_to", "to", OperandRole::kUse, false},
+  {"set_to", "to_entry", OperandRole::kIgnore, false},
+  {"set_up_down", "x", OperandRole::kUseDef, false},
+  {"set_up_down", "by", OperandRole::kUse, false},
+  {"read_statement", "into", OperandRole::kDef, false},
+  {"return_statement", "into", OperandRole::kDef, false},
+  {nullptr, nullptr, OperandRole::kUse, false},
+};
+
+const ts_native::DataFlowRules data_flow = {
+  data_flow_statements,
+  data_flow_references,
+  data_flow_subscripts,
+  data_flow_skipped,
+  data_flow_operands,
+};
+
+const ts_native::Grammar grammar = {
+  "COBOL",
+  tree_sitter_COBOL(),
+  tree_sitter_COBOL_external_scanner_set_source_areas_stripped,
+  true,
+  &data_flow,
+  true,
+  ts_native::extract_cobol_skeleton,
+  true,
+};
+
 NAN_METHOD(New) {}
 
-void Init(Local<Object> exports, Local<Object> module) {
+void Init(Local<Object> exports, Local<Object> module, Local<Context> context) {
+  ts_native::AddonData *data = ts_native::AddonData::New(context->GetIsolate(), &grammar);
+
   Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(New);
   tpl->SetClassName(Nan::New("Language").ToLocalChecked());
   tpl->InstanceTemplate()->SetInternalFieldCount(1);
 
   Local<Function> constructor = Nan::GetFunction(tpl).ToLocalChecked();
-  Local<Object> instance = constructor->NewInstance(Nan::GetCurrentContext()).ToLocalChecked();
+  Local<Object> instance = constructor->NewInstance(context).ToLocalChecked();
   Nan::SetInternalFieldPointer(instance, 0, tree_sitter_COBOL());
 
   Nan::Set(instance, Nan::New("name").ToLocalChecked(), Nan::New("COBOL").ToLocalChecked());
+  ts_native::InitLanguage(instance, data);
   Nan::Set(module, Nan::New("exports").ToLocalChecked(), instance);
 }
 
-NODE_MODULE(tree_sitter_COBOL_binding, Init)
-
 }  // namespace
+
+// Context-aware registration, so the addon can be loaded from several
+// worker_threads Workers; NODE_MODULE would refuse the second load.
+NODE_MODULE_INIT() {
+  Init(exports, module.As<Object>(), context);
+}
@@ -14,6 +14,8 @@ try {
   }
 }
 
+require("../../../native/bindings/node")(module.exports);
+
 try {
   module.exports.nodeTypeInfo = require("../../src/node-types.json");
 } catch (_) {}
@@ -19,6 +19,8 @@ module.exports = grammar({
     $._LINE_COMMENT,
     $.comment_entry,
     $._multiline_string,
+    $.exec_sql,
+    $.compiler_directive,
   ],
 
   extras: $ => [
@@ -29,6 +31,7 @@ module.exports = grammar({
     $._LINE_COMMENT_ALIAS,
     $.copy_statement,
     $.comment,
+    $.compiler_directive,
   ],
 
   rules: {
@@ -870,12 +873,12 @@ module.exports = grammar({
     ),
 
     record_description_list: $ => seq(
-      repeat1(seq($.data_description, repeat1('.')))
+      repeat1(seq(choice($.data_description, $.exec_sql), repeat1('.')))
     ),
 
     working_storage_section: $ => seq(
       $._WORKING_STORAGE, $._SECTION, '.',
-      repeat(seq($.data_description, repeat1('.')))
+      repeat(seq(choice($.data_description, $.exec_sql), repeat1('.')))
     ),
 
     data_description: $ => choice(
@@ -1401,6 +1404,7 @@ module.exports = grammar({
       $.use_statement,
       $.write_statement,
       $.next_sentence_statement,
+      $.exec_sql,
     ),
 
     _end_statement: $ => choice(
@@ -1,5 +1,7 @@
 #include <tree_sitter/parser.h>
-#include <wctype.h>
+#include <string.h>
+
+#include "char_class.h"
 
 enum TokenType {
     WHITE_SPACES,
@@ -8,83 +10,233 @@ enum TokenType {
     LINE_COMMENT,
     COMMENT_ENTRY,
     multiline_string,
+    EXEC_SQL,
+    COMPILER_DIRECTIVE,
 };
 
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+// Set while the calling thread parses through included ranges that already
+// leave out the sequence, indicator and identification areas (see
+// parsers/native/src/source_areas.h). get_column() then counts only the
+// visible text, so the column-based comment tokens are switched off and a
+// continuation line starts directly at its '-' indicator.
+//
+// The flag is not part of the scanner's state: only parse_source switches
+// it, around each fixed-format parse. Any other parse through such ranges,
+// with node-tree-sitter's setIncludedRanges or as an incremental reparse of
+// a stripped tree, has to switch it on the parsing thread itself, or the
+// comment tokens are read at the wrong columns.
+static THREAD_LOCAL bool source_areas_stripped = false;
+
+void tree_sitter_COBOL_external_scanner_set_source_areas_stripped(bool stripped) {
+    source_areas_stripped = stripped;
+}
+
 void *tree_sitter_COBOL_external_scanner_create() {
     return NULL;
 }
 
-static bool is_white_space(int c) {
-    return iswspace(c) || c == ';' || c == ',';
+// The lexer together with its current column. lexer->get_column() makes the
+// runtime re-read the line from its start, which turns the per-character
+// loops below quadratic in the line length, so it is called once per scan
+// and the column is tracked by hand from there on.
+typedef struct {
+    TSLexer *lexer;
+    uint32_t column;
+} Cursor;
+
+static void advance(Cursor *cursor, bool skip) {
+    TSLexer *lexer = cursor->lexer;
+    if(lexer->eof(lexer)) {
+        return;
+    }
+    cursor->column = lexer->lookahead == '\n' ? 0 : cursor->column + 1;
+    lexer->advance(lexer, skip);
+}
+
+static bool is_white_space(int32_t c) {
+    return char_is(c, CHAR_SEPARATOR) || (c >= 256 && char_is_space(c));
 }
 
-const int number_of_comment_entry_keywords = 9;
-char* any_content_keyword[] = {
-    "author",
-    "installlation",
-    "date-written",
-    "date-compiled",
-    "security",
-    "identification division",
-    "environment division",
-    "data division",
-    "procedure division",
+// The words that end a comment entry at the head of a line, in upper case
+// and at the slot of their perfect hash: the hash of the first and sixth
+// characters, which are all that tell the nine apart. Every keyword has at
+// least six characters.
+#define COMMENT_ENTRY_KEYWORD_HEAD 6
+
+static const char *const comment_entry_keywords[16] = {
+    [0] = "DATA DIVISION",
+    [2] = "ENVIRONMENT DIVISION",
+    [3] = "DATE-WRITTEN",
+    [4] = "PROCEDURE DIVISION",
+    [8] = "IDENTIFICATION DIVISION",
+    [9] = "AUTHOR",
+    [11] = "INSTALLATION",
+    [14] = "SECURITY",
+    [15] = "DATE-COMPILED",
 };
 
-static bool start_with_word( TSLexer *lexer, char *words[], int number_of_words) {
-    while(lexer->lookahead == ' ' || lexer->lookahead == '\t') {
-        lexer->advance(lexer, true);
-    }
+static unsigned comment_entry_keyword_hash(int32_t first, int32_t sixth) {
+    return ((unsigned)first * 7 + (unsigned)sixth) & 15;
+}
+
+static bool at_line_end(Cursor *cursor) {
+    TSLexer *lexer = cursor->lexer;
+    return cursor->column > 71 || lexer->lookahead == '\n' || lexer->lookahead == 0;
+}
 
-    char *keyword_pointer[number_of_words];
-    bool continue_check[number_of_words];
-    for(int i=0; i<number_of_words; ++i) {
-        keyword_pointer[i] = words[i];
-        continue_check[i] = true;
+// Whether the line goes on with one of the comment entry keywords, ignoring
+// case and leading blanks. The line is read once: its first six characters
+// pick the only keyword it can start with, and the rest is compared with
+// that one. A character outside ASCII in them rules every keyword out. When
+// there is none, the cursor is left at the end of area B.
+static bool starts_with_comment_entry_keyword(Cursor *cursor) {
+    TSLexer *lexer = cursor->lexer;
+    while(lexer->lookahead == ' ' || lexer->lookahead == '\t') {
+        advance(cursor, true);
     }
 
-    while(true) {
-        // At the end of the line
-        if(lexer->get_column(lexer) > 71 || lexer->lookahead == '\n' || lexer->lookahead == 0) {
+    char head[COMMENT_ENTRY_KEYWORD_HEAD];
+    bool ascii = true;
+    for(int i=0; i<COMMENT_ENTRY_KEYWORD_HEAD && ascii; ++i) {
+        if(at_line_end(cursor)) {
             return false;
         }
+        int32_t upper = char_to_upper(lexer->lookahead);
+        if((uint32_t)upper > 0x7F) {
+            ascii = false;
+        } else {
+            head[i] = (char)upper;
+        }
+        advance(cursor, true);
+    }
 
-        // If all keyword matching fails, move to the end of the line
-        bool all_match_failed = true;
-        for(int i=0; i<number_of_words; ++i) {
-            if(continue_check[i]) {
-                all_match_failed = false;
+    const char *keyword = ascii ? comment_entry_keywords[comment_entry_keyword_hash(
+        (unsigned char)head[0], (unsigned char)head[COMMENT_ENTRY_KEYWORD_HEAD - 1])] : NULL;
+    if(keyword != NULL && memcmp(head, keyword, COMMENT_ENTRY_KEYWORD_HEAD) == 0) {
+        for(keyword += COMMENT_ENTRY_KEYWORD_HEAD; !at_line_end(cursor); ++keyword) {
+            if(*keyword == 0) {
+                return true;
             }
+            if(char_to_upper(lexer->lookahead) != *keyword) {
+                break;
+            }
+            advance(cursor, true);
         }
+    }
 
-        if(all_match_failed) {
-            for(; lexer->get_column(lexer) < 71 && lexer->lookahead != '\n' && lexer->lookahead != 0;
-            lexer->advance(lexer, true)) {
-            }
+    while(!at_line_end(cursor)) {
+        advance(cursor, true);
+    }
+    return false;
+}
+
+static bool is_word_char(int32_t c) {
+    return char_is(c, CHAR_WORD);
+}
+
+// Consumes `word`, given in upper case, if it is next as a whole word.
+static bool match_word(Cursor *cursor, const char *word) {
+    TSLexer *lexer = cursor->lexer;
+    for(; *word != 0; ++word) {
+        if(char_to_upper(lexer->lookahead) != *word) {
             return false;
         }
+        advance(cursor, false);
+    }
+    return !is_word_char(lexer->lookahead);
+}
 
-        // If the head of the line matches any of specified keywords, return true;
-        char c = lexer->lookahead;
-        for(int i=0; i<number_of_words; ++i) {
-            if(*(keyword_pointer[i]) == 0 && continue_check[i]) {
-                return true;
+// EXEC SQL ... END-EXEC as one token, so that the SQL never reaches the
+// COBOL rules and their error recovery. The block is read once, up to the
+// first END-EXEC that stands as a word of its own outside an SQL string
+// literal. Unless the source areas are stripped, the sequence and
+// identification areas and comment lines inside the block are skipped over,
+// so that nothing in them ends it. A separator period, a '.' before a blank
+// or the end of the file, ends the COBOL sentence and the search with it:
+// a block without END-EXEC is no token at all, and finding that out reads
+// only as far as the sentence goes, not to the end of the file each time.
+static bool scan_exec_sql(Cursor *cursor) {
+    static const char end_exec[] = "END-EXEC";
+    TSLexer *lexer = cursor->lexer;
+    if(!match_word(cursor, "EXEC")) {
+        return false;
+    }
+    while(lexer->lookahead == ' ' || lexer->lookahead == '\t') {
+        advance(cursor, false);
+    }
+    if(!match_word(cursor, "SQL")) {
+        return false;
+    }
+
+    int matched = 0;
+    int quote = 0;
+    int previous = ' ';
+    while(!lexer->eof(lexer)) {
+        int c = lexer->lookahead;
+        if(c == '\n') {
+            // SQL string literals do not span lines without a continuation.
+            quote = 0;
+            matched = 0;
+            previous = c;
+            advance(cursor, false);
+            continue;
+        }
+        if(!source_areas_stripped && (cursor->column < 6 || cursor->column >= 72)) {
+            matched = 0;
+            advance(cursor, false);
+            continue;
+        }
+        if(!source_areas_stripped && cursor->column == 6) {
+            if(c == '*' || c == '/') {
+                while(lexer->lookahead != '\n' && !lexer->eof(lexer)) {
+                    advance(cursor, false);
+                }
+            } else {
+                advance(cursor, false);
             }
+            previous = ' ';
+            continue;
         }
 
-        // matching keywords
-        for(int i=0; i<number_of_words; ++i) {
-            char k = *(keyword_pointer[i]);
-            if(continue_check[i]) {
-                continue_check[i] = c == towupper(k) || c == towlower(k);
+        if(quote != 0) {
+            if(c == quote) {
+                quote = 0;
+            }
+        } else if(c == '\'' || c == '"') {
+            quote = c;
+            matched = 0;
+        } else if(c == '.') {
+            advance(cursor, false);
+            if(char_is(lexer->lookahead, CHAR_SPACE) || lexer->eof(lexer)) {
+                return false;
+            }
+            matched = 0;
+            previous = c;
+            continue;
+        } else if(char_to_upper(c) == end_exec[matched] &&
+                  (matched > 0 || !is_word_char(previous))) {
+            if(++matched == sizeof(end_exec) - 1) {
+                advance(cursor, false);
+                if(!is_word_char(lexer->lookahead)) {
+                    lexer->mark_end(lexer);
+                    return true;
+                }
+                matched = 0;
+                previous = c;
+                continue;
             }
-            (keyword_pointer[i])++;
+        } else {
+            matched = 0;
         }
-
-        // next character
-        lexer->advance(lexer, true);
+        previous = c;
+        advance(cursor, false);
     }
-
     return false;
 }
 
@@ -94,10 +246,12 @@ bool tree_sitter_COBOL_external_scanner_scan(void *payload, TSLexer *lexer,
         return false;
     }
 
+    Cursor cursor = { lexer, lexer->get_column(lexer) };
+
     if(valid_symbols[WHITE_SPACES]) {
         if(is_white_space(lexer->lookahead)) {
             while(is_white_space(lexer->lookahead)) {
-                lexer->advance(lexer, true);
+                advance(&cursor, true);
             }
             lexer->result_symbol = WHITE_SPACES;
             lexer->mark_end(lexer);
@@ -105,36 +259,50 @@ bool tree_sitter_COBOL_external_scanner_scan(void *payload, TSLexer *lexer,
         }
     }
 
-    if(valid_symbols[LINE_PREFIX_COMMENT] && lexer->get_column(lexer) <= 5) {
-        while(lexer->get_column(lexer) <= 5) {
-            lexer->advance(lexer, true);
+    // A compiler directive line, '?' in the indicator area or, as Tandem
+    // writes them, in column 1: ?SOURCE, ?SEARCH, ?HEADING and the like. One
+    // token to the end of the line, rather than the ERROR nodes the rules
+    // would make of it. Stripped source areas leave these lines out.
+    if(valid_symbols[COMPILER_DIRECTIVE] && !source_areas_stripped &&
+       lexer->lookahead == '?' && (cursor.column == 0 || cursor.column == 6)) {
+        while(lexer->lookahead != '\n' && !lexer->eof(lexer)) {
+            advance(&cursor, false);
+        }
+        lexer->result_symbol = COMPILER_DIRECTIVE;
+        lexer->mark_end(lexer);
+        return true;
+    }
+
+    if(valid_symbols[LINE_PREFIX_COMMENT] && !source_areas_stripped && cursor.column <= 5) {
+        while(cursor.column <= 5 && !lexer->eof(lexer)) {
+            advance(&cursor, true);
         }
         lexer->result_symbol = LINE_PREFIX_COMMENT;
         lexer->mark_end(lexer);
         return true;
     }
 
-    if(valid_symbols[LINE_COMMENT]) {
-        if(lexer->get_column(lexer) == 6) {
+    if(valid_symbols[LINE_COMMENT] && !source_areas_stripped) {
+        if(cursor.column == 6) {
             if(lexer->lookahead == '*' || lexer->lookahead == '/') {
                 while(lexer->lookahead != '\n' && lexer->lookahead != 0) {
-                    lexer->advance(lexer, true);
+                    advance(&cursor, true);
                 }
                 lexer->result_symbol = LINE_COMMENT;
                 lexer->mark_end(lexer);
                 return true;
             } else {
-                lexer->advance(lexer, true);
+                advance(&cursor, true);
                 lexer->mark_end(lexer);
                 return false;
             }
         }
     }
 
-    if(valid_symbols[LINE_SUFFIX_COMMENT]) {
-        if(lexer->get_column(lexer) >= 72) {
+    if(valid_symbols[LINE_SUFFIX_COMMENT] && !source_areas_stripped) {
+        if(cursor.column >= 72) {
             while(lexer->lookahead != '\n' && lexer->lookahead != 0) {
-                lexer->advance(lexer, true);
+                advance(&cursor, true);
             }
             lexer->result_symbol = LINE_SUFFIX_COMMENT;
             lexer->mark_end(lexer);
@@ -143,7 +311,7 @@ bool tree_sitter_COBOL_external_scanner_scan(void *payload, TSLexer *lexer,
     }
 
     if(valid_symbols[COMMENT_ENTRY]) {
-        if(!start_with_word(lexer, any_content_keyword, number_of_comment_entry_keywords)) {
+        if(!starts_with_comment_entry_keyword(&cursor)) {
             lexer->mark_end(lexer);
             lexer->result_symbol = COMMENT_ENTRY;
             return true;
@@ -152,43 +320,52 @@ bool tree_sitter_COBOL_external_scanner_scan(void *payload, TSLexer *lexer,
         }
     }
 
+    if(valid_symbols[EXEC_SQL] && (lexer->lookahead == 'E' || lexer->lookahead == 'e')) {
+        if(scan_exec_sql(&cursor)) {
+            lexer->result_symbol = EXEC_SQL;
+            return true;
+        }
+        return false;
+    }
+
     if(valid_symbols[multiline_string]) {
         while(true) {
             if(lexer->lookahead != '"') {
                 return false;
             }
-            lexer->advance(lexer, false);
-            while(lexer->lookahead != '"' && lexer->lookahead != 0 && lexer->get_column(lexer) < 72) {
-                lexer->advance(lexer, false);
+            advance(&cursor, false);
+            while(lexer->lookahead != '"' && lexer->lookahead != '\n' &&
+                  lexer->lookahead != 0 && cursor.column < 72) {
+                advance(&cursor, false);
             }
             if(lexer->lookahead == '"') {
                 lexer->result_symbol = multiline_string;
-                lexer->advance(lexer, false);
+                advance(&cursor, false);
                 lexer->mark_end(lexer);
                 return true;
             }
             while(lexer->lookahead != 0 && lexer->lookahead != '\n') {
-                lexer->advance(lexer, true);
+                advance(&cursor, true);
             }
             if(lexer->lookahead == 0) {
                 return false;
             }
-            lexer->advance(lexer, true);
+            advance(&cursor, true);
             int i;
-            for(i=0; i<=5; ++i) {
+            for(i=0; i<=5 && !source_areas_stripped; ++i) {
                 if(lexer->lookahead == 0 || lexer->lookahead == '\n') {
                     return false;
                 }
-                lexer->advance(lexer, true);
+                advance(&cursor, true);
             }
 
             if(lexer->lookahead != '-') {
                 return false;
             }
 
-            lexer->advance(lexer, true);
-            while(lexer->lookahead == ' ' && lexer->get_column(lexer) < 72) {
-                lexer->advance(lexer, true);
+            advance(&cursor, true);
+            while(lexer->lookahead == ' ' && cursor.column < 72) {
+                advance(&cursor, true);
             }
         }
     }
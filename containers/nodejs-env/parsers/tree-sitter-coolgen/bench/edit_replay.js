@@ -0,0 +1,127 @@
+// Replays editor keystrokes against every module of a directory and compares
+// incremental reparses (tree.edit + parse with the old tree) with parsing the
+// edited text from scratch:
+//
+//   node bench/edit_replay.js [dir] [edits-per-file]
+//
+// Each keystroke types an "x" at the end of a procedure statement line and
+// then deletes it again, so every module goes through 2 * edits reparses. The
+// incremental tree is checked against the full parse after every reparse; any
+// difference means scanner state was lost across the edit.
+//
+// Without the tree-sitter package or the addon built against it there is
+// nothing to time; the script then says so and exits with 2, so a missing
+// measurement never reads as a passing one.
+const fs = require("fs");
+const path = require("path");
+
+function load(name, what) {
+  try {
+    return require(name);
+  } catch (error) {
+    console.error(`edit_replay: not measured, ${what} cannot be loaded: ` +
+      `${error.message.split("\n")[0]}`);
+    console.error("Run `npm install` in tree-sitter-coolgen first.");
+    process.exit(2);
+  }
+}
+
+const Parser = load("tree-sitter", "the tree-sitter package");
+const CoolGen = load("..", "the CoolGen addon");
+
+const dir = process.argv[2] || path.join(__dirname, "..", "test", "yyy");
+const editsPerFile = Number(process.argv[3]) || 20;
+
+function pointAt(text, index) {
+  let row = 0;
+  let lineStart = 0;
+  for (let i = text.indexOf("\n"); i !== -1 && i < index; i = text.indexOf("\n", i + 1)) {
+    row++;
+    lineStart = i + 1;
+  }
+  return { row, column: index - lineStart };
+}
+
+// Ends of the statement lines, the places an editor user types at.
+function editOffsets(text) {
+  const body = text.indexOf("PROCEDURE STATEMENTS");
+  const offsets = [];
+  const lineEnd = /[^\r\n]\r?\n/g;
+  lineEnd.lastIndex = body === -1 ? 0 : body;
+  for (let match; (match = lineEnd.exec(text)) !== null;) {
+    offsets.push(match.index + 1);
+  }
+  const step = Math.max(1, Math.floor(offsets.length / editsPerFile));
+  return offsets.filter((_, i) => i % step === 0).slice(0, editsPerFile);
+}
+
+function applyEdit(text, tree, index, deleted, inserted) {
+  const next = text.slice(0, index) + inserted + text.slice(index + deleted.length);
+  tree.edit({
+    startIndex: index,
+    oldEndIndex: index + deleted.length,
+    newEndIndex: index + inserted.length,
+    startPosition: pointAt(text, index),
+    oldEndPosition: pointAt(text, index + deleted.length),
+    newEndPosition: pointAt(next, index + inserted.length),
+  });
+  return next;
+}
+
+function time(fn) {
+  const start = process.hrtime.bigint();
+  const value = fn();
+  return [value, Number(process.hrtime.bigint() - start) / 1e6];
+}
+
+function percentile(sorted, p) {
+  return sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * p))];
+}
+
+function report(label, samples) {
+  const sorted = samples.slice().sort((a, b) => a - b);
+  const mean = sorted.reduce((a, b) => a + b, 0) / sorted.length;
+  console.log(`${label.padEnd(12)} mean ${mean.toFixed(3)} ms  ` +
+    `p50 ${percentile(sorted, 0.5).toFixed(3)} ms  p99 ${percentile(sorted, 0.99).toFixed(3)} ms`);
+}
+
+function main() {
+  const files = fs.readdirSync(dir)
+    .filter((name) => name.endsWith(".gensrc"))
+    .sort()
+    .map((name) => path.join(dir, name));
+
+  const incrementalParser = new Parser();
+  const fullParser = new Parser();
+  incrementalParser.setLanguage(CoolGen);
+  fullParser.setLanguage(CoolGen);
+
+  const incremental = [];
+  const full = [];
+  let mismatches = 0;
+  for (const file of files) {
+    let text = fs.readFileSync(file, "utf8");
+    let tree = incrementalParser.parse(text);
+    for (const offset of editOffsets(text)) {
+      for (const [deleted, inserted] of [["", "x"], ["x", ""]]) {
+        text = applyEdit(text, tree, offset, deleted, inserted);
+        const [edited, incrementalMs] = time(() => incrementalParser.parse(text, tree));
+        const [fresh, fullMs] = time(() => fullParser.parse(text));
+        incremental.push(incrementalMs);
+        full.push(fullMs);
+        if (edited.rootNode.toString() !== fresh.rootNode.toString()) {
+          mismatches++;
+        }
+        tree = edited;
+      }
+    }
+  }
+
+  console.log(`${files.length} files, ${incremental.length} reparses`);
+  report("incremental", incremental);
+  report("full", full);
+  console.log(`${mismatches} incremental trees differ from a full parse`);
+  if (mismatches > 0) process.exitCode = 1;
+}
+
+main();
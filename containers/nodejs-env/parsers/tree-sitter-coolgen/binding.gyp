@@ -1,19 +1,97 @@
 {
+  "variables": {
+    "tree_sitter_lib%": "<!(node -p \"require('path').join(require('path').dirname(require.resolve('tree-sitter/package.json')), 'vendor', 'tree-sitter', 'lib')\")",
+    # Profile-guided optimization, driven by ../pgo.sh:
+    #   node-gyp rebuild -- -Dpgo=generate|use -Dpgo_dir=<profile directory>
+    "pgo%": "",
+    "pgo_dir%": "<(module_root_dir)/pgo-profile",
+    # gcc or clang, from $CC as node-gyp's make build uses it. GCC takes a
+    # couple of -fprofile-use companions Clang rejects.
+    "pgo_compiler%": "<!(node -p \"try { /clang/.test(require('child_process').execSync((process.env.CC || 'cc') + ' --version', {stdio: ['ignore', 'pipe', 'ignore']})) ? 'clang' : 'gcc' } catch (e) { 'gcc' }\")"
+  },
+  "target_defaults": {
+    "conditions": [
+      ["pgo=='generate'", {
+        "cflags": [
+          "-fprofile-generate=<(pgo_dir)",
+          "-fprofile-update=atomic",
+        ],
+        "ldflags": [
+          "-fprofile-generate=<(pgo_dir)",
+        ]
+      }],
+      ["pgo=='use'", {
+        "cflags": [
+          "-fprofile-use=<(pgo_dir)",
+        ]
+      }],
+      ["pgo=='use' and pgo_compiler=='gcc'", {
+        "cflags": [
+          "-fprofile-correction",
+          "-Wno-missing-profile",
+        ]
+      }]
+    ]
+  },
   "targets": [
     {
       "target_name": "tree_sitter_coolgen_binding",
+      "dependencies": [
+        "tree_sitter_runtime"
+      ],
       "include_dirs": [
         "<!(node -e \"require('nan')\")",
-        "src"
+        "src",
+        "<(tree_sitter_lib)/include",
+        "../native/src",
+        "../native/bindings/node"
       ],
       "sources": [
         "bindings/node/binding.cc",
         "src/parser.c",
+        "src/scanner.c",
         # If your language uses an external scanner, add it here.
+        "../native/src/arena.cc",
+        "../native/src/batch_parse.cc",
+        "../native/src/code_page.cc",
+        "../native/src/copybook.cc",
+        "../native/src/data_flow.cc",
+        "../native/src/embedded_sql.cc",
+        "../native/src/flat_tree.cc",
+        "../native/src/parse_cache.cc",
+        "../native/src/program_split.cc",
+        "../native/src/query.cc",
+        "../native/src/skeleton.cc",
+        "../native/src/source_areas.cc",
+        "../native/bindings/node/code_page_binding.cc",
+        "../native/bindings/node/flat_tree_binding.cc",
+        "../native/bindings/node/native_binding.cc",
+        "../native/bindings/node/parse_files.cc",
+        "../native/bindings/node/query_binding.cc"
+      ],
+      "defines": [
+        # The scanner allocates through the runtime, see native/src/arena.h.
+        "TREE_SITTER_REUSE_ALLOCATOR"
       ],
       "cflags_c": [
         "-std=c99",
       ]
+    },
+    {
+      # The tree-sitter runtime vendored by node-tree-sitter, linked statically
+      # so the native batch APIs can parse without going through JS.
+      "target_name": "tree_sitter_runtime",
+      "type": "static_library",
+      "include_dirs": [
+        "<(tree_sitter_lib)/src",
+        "<(tree_sitter_lib)/include"
+      ],
+      "sources": [
+        "<(tree_sitter_lib)/src/lib.c"
+      ],
+      "cflags_c": [
+        "-std=c11",
+      ]
     }
   ]
 }
@@ -1,6 +1,9 @@
 #include "tree_sitter/parser.h"
 #include <node.h>
 #include "nan.h"
+#include "native_binding.h"
+#include "data_flow.h"
+#include "skeleton.h"
 
 using namespace v8;
 
@@ -8,21 +11,82 @@ extern "C" TSLanguage * tree_sitter_coolgen();
 
 namespace {
 
+using ts_native::OperandRole;
+
+const char *const data_flow_statements[] = {
+  "set_statement", "move_statement", "import_param", "export_param",
+  "for_statement", nullptr,
+};
+const char *const data_flow_references[] = {
+  "attribute", "entity_attribute", "group_subscript", "group_last", nullptr,
+};
+const char *const data_flow_subscripts[] = {nullptr};
+const char *const data_flow_skipped[] = {"noteline", nullptr};
+
+// MOVE and the USE parameter lists copy whole views, which are named by bare
+// identifiers. An import copies the caller's view into the callee's import
+// view, an export the callee's export view back into the caller's.
+const ts_native::DataFlowOperand data_flow_operands[] = {
+  {"set_statement", "right", OperandRole::kUse, false},
+  {"set_statement", "left", OperandRole::kDef, false},
+  {"move_statement", "right", OperandRole::kUse, true},
+  {"move_statement", "left", OperandRole::kDef, true},
+  {"move_statement", "source_view_descriptor", OperandRole::kIgnore, false},
+  {"move_statement", "dest_view_descriptor", OperandRole::kIgnore, false},
+  {"import_param", "source_view_name", OperandRole::kUse, true},
+  {"import_param", "dest_view_name", OperandRole::kDef, true},
+  {"import_param", "source_view_descriptor", OperandRole::kIgnore, false},
+  {"import_param", "dest_view_descriptor", OperandRole::kIgnore, false},
+  {"export_param", "source_view_name", OperandRole::kUse, true},
+  {"export_param", "dest_view_name", OperandRole::kDef, true},
+  {"export_param", "source_view_descriptor", OperandRole::kIgnore, false},
+  {"export_param", "dest_view_descriptor", OperandRole::kIgnore, false},
+  {"for_statement", "right", OperandRole::kUse, false},
+  {"for_statement", "left", OperandRole::kDef, false},
+  {nullptr, nullptr, OperandRole::kUse, false},
+};
+
+const ts_native::DataFlowRules data_flow = {
+  data_flow_statements,
+  data_flow_references,
+  data_flow_subscripts,
+  data_flow_skipped,
+  data_flow_operands,
+};
+
+const ts_native::Grammar grammar = {
+  "coolgen",
+  tree_sitter_coolgen(),
+  nullptr,
+  false,
+  &data_flow,
+  false,
+  ts_native::extract_coolgen_skeleton,
+  false,
+};
+
 NAN_METHOD(New) {}
 
-void Init(Local<Object> exports, Local<Object> module) {
+void Init(Local<Object> exports, Local<Object> module, Local<Context> context) {
+  ts_native::AddonData *data = ts_native::AddonData::New(context->GetIsolate(), &grammar);
+
   Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(New);
   tpl->SetClassName(Nan::New("Language").ToLocalChecked());
   tpl->InstanceTemplate()->SetInternalFieldCount(1);
 
   Local<Function> constructor = Nan::GetFunction(tpl).ToLocalChecked();
-  Local<Object> instance = constructor->NewInstance(Nan::GetCurrentContext()).ToLocalChecked();
+  Local<Object> instance = constructor->NewInstance(context).ToLocalChecked();
   Nan::SetInternalFieldPointer(instance, 0, tree_sitter_coolgen());
 
   Nan::Set(instance, Nan::New("name").ToLocalChecked(), Nan::New("coolgen").ToLocalChecked());
+  ts_native::InitLanguage(instance, data);
   Nan::Set(module, Nan::New("exports").ToLocalChecked(), instance);
 }
 
-NODE_MODULE(tree_sitter_coolgen_binding, Init)
-
 }  // namespace
+
+// Context-aware registration, so the addon can be loaded from several
+// worker_threads Workers; NODE_MODULE would refuse the second load.
+NODE_MODULE_INIT() {
+  Init(exports, module.As<Object>(), context);
+}
@@ -1,43 +1,10 @@
+#include "tree_sitter/alloc.h"
 #include "tree_sitter/parser.h"
 
-#include <assert.h>
 #include <stdint.h>
-#include <stdio.h>
 #include <string.h>
 
-#define MAX(a, b) ((a) > (b) ? (a) : (b))
-
-#define VEC_RESIZE(vec, _cap)                                                  \
-    void *tmp = realloc((vec).data, (_cap) * sizeof((vec).data[0]));           \
-    assert(tmp != NULL);                                                       \
-    (vec).data = tmp;                                                          \
-    (vec).cap = (_cap);
-
-#define VEC_GROW(vec, _cap)                                                    \
-    if ((vec).cap < (_cap)) {                                                  \
-        VEC_RESIZE((vec), (_cap));                                             \
-    }
-
-#define VEC_PUSH(vec, el)                                                      \
-    if ((vec).cap == (vec).len) {                                              \
-        VEC_RESIZE((vec), MAX(16, (vec).len * 2));                             \
-    }                                                                          \
-    (vec).data[(vec).len++] = (el);
-
-#define VEC_POP(vec) (vec).len--;
-
-#define VEC_NEW                                                                \
-    { .len = 0, .cap = 0, .data = NULL }
-
-#define VEC_BACK(vec) ((vec).data[(vec).len - 1])
-
-#define VEC_FREE(vec)                                                          \
-    {                                                                          \
-        if ((vec).data != NULL)                                                \
-            free((vec).data);                                                  \
-    }
-
-#define VEC_CLEAR(vec) (vec).len = 0;
+#include "char_class.h"
 
 enum TokenType {
     NOTE_TERMINATOR,
@@ -51,128 +18,18 @@ enum TokenType {
     ERROR_SENTINEL,
 };
 
-typedef enum {
-    SingleQuote = 1 << 0,
-    DoubleQuote = 1 << 1,
-    BackQuote = 1 << 2,
-    Raw = 1 << 3,
-    Format = 1 << 4,
-    Triple = 1 << 5,
-    Bytes = 1 << 6,
-} Flags;
-
-typedef struct {
-    char flags;
-} Delimiter;
-
-static char ENTITY[] = "Entity";
-static char GROUP[] = "Group";
-static char WORK[] = "Work";
-
-static inline Delimiter new_delimiter() { return (Delimiter){0}; }
-
-static inline bool is_format(Delimiter *delimiter) {
-    return delimiter->flags & Format;
-}
-
-static inline bool is_raw(Delimiter *delimiter) {
-    return delimiter->flags & Raw;
-}
-
-static inline bool is_triple(Delimiter *delimiter) {
-    return delimiter->flags & Triple;
-}
-
-static inline bool is_bytes(Delimiter *delimiter) {
-    return delimiter->flags & Bytes;
-}
-
-static inline int32_t end_character(Delimiter *delimiter) {
-    if (delimiter->flags & SingleQuote) {
-        return '\'';
-    }
-    if (delimiter->flags & DoubleQuote) {
-        return '"';
-    }
-    if (delimiter->flags & BackQuote) {
-        return '`';
-    }
-    return 0;
-}
-
-static inline void set_format(Delimiter *delimiter) {
-    delimiter->flags |= Format;
-}
-
-static inline void set_raw(Delimiter *delimiter) { delimiter->flags |= Raw; }
-
-static inline void set_triple(Delimiter *delimiter) {
-    delimiter->flags |= Triple;
-}
-
-static inline void set_bytes(Delimiter *delimiter) {
-    delimiter->flags |= Bytes;
-}
-
-static inline void set_end_character(Delimiter *delimiter, int32_t character) {
-    switch (character) {
-        case '\'':
-            delimiter->flags |= SingleQuote;
-            break;
-        case '"':
-            delimiter->flags |= DoubleQuote;
-            break;
-        case '`':
-            delimiter->flags |= BackQuote;
-            break;
-        default:
-            assert(false);
-    }
-}
-
 static inline bool isDigit(int32_t character) {
-    return (character >= '0' && character <= '9');
-}
-
-static inline bool isAlphabetic(int32_t character) {
-    return ((character >= 'A' && character <= 'Z') || (character >= 'a' && character <= 'z'));
-}
-
-static inline bool isIDPart(int32_t character) {
-    return (isDigit(character) || isAlphabetic(character) || (character == '_'));
+    return char_is(character, CHAR_DIGIT);
 }
 
+// The whole scanner state. current_si, the number of the statement being
+// read, decides between STATEMENT_ID, STATEMENT_PART and BLOCK_ID; no other
+// CoolGen token depends on what came before it. The indent and delimiter
+// stacks of the Python scanner this one started from (test/ref_scanner.c)
+// are gone: nothing here pushed them, yet they were allocated on create and
+// rebuilt on every deserialize.
 typedef struct {
-    uint32_t len;
-    uint32_t cap;
-    uint16_t *data;
-} indent_vec;
-
-static indent_vec indent_vec_new() {
-    indent_vec vec = VEC_NEW;
-    vec.data = calloc(1, sizeof(uint16_t));
-    vec.cap = 1;
-    return vec;
-}
-
-typedef struct {
-    uint32_t len;
-    uint32_t cap;
-    Delimiter *data;
-} delimiter_vec;
-
-static delimiter_vec delimiter_vec_new() {
-    delimiter_vec vec = VEC_NEW;
-    vec.data = calloc(1, sizeof(Delimiter));
-    vec.cap = 1;
-    return vec;
-}
-
-typedef struct {
-    indent_vec indents;
-    delimiter_vec delimiters;
-    bool inside_f_string;
-    int current_si;
+    int32_t current_si;
 } Scanner;
 
 static inline void advance(TSLexer *lexer) { lexer->advance(lexer, false); }
@@ -187,28 +44,6 @@ bool tree_sitter_coolgen_external_scanner_scan(void *payload, TSLexer *lexer,
 
     lexer->mark_end(lexer);
 
-//    if (valid_symbols[IDENTIFIER] && !error_recovery_mode) {
-//   
-//	while (lexer->lookahead && lexer->lookahead == ' ') {
-//             skip(lexer);
-//        }
-//
-//        if (lexer->lookahead && (isDigit(lexer->lookahead) || isAlphabetic(lexer->lookahead))) {
-//
-//          int alphas = 0;
-//	  while (lexer->lookahead && isIDPart(lexer->lookahead)) {
-//             if (isAlphabetic(lexer->lookahead))
-//                alphas++;
-//             advance(lexer);
-//          }
-//   
-//          if (alphas > 0) {
-//             lexer->result_symbol = IDENTIFIER;
-//             return true;
-//          }
-//        }
-//    } 
-
     if ((valid_symbols[STATEMENT_ID] || valid_symbols[STATEMENT_PART] || valid_symbols[BLOCK_ID]) && !error_recovery_mode) {
     
 	while (lexer->lookahead && 
@@ -325,33 +160,13 @@ bool tree_sitter_coolgen_external_scanner_scan(void *payload, TSLexer *lexer,
     return false;
 }
 
+// The runtime restores the state before every external scan, so both
+// directions are a single memcpy. It has to round-trip, or tokens lexed
+// after ts_tree_edit() see the statement number of whatever was lexed last.
 unsigned tree_sitter_coolgen_external_scanner_serialize(void *payload,
                                                        char *buffer) {
-    Scanner *scanner = (Scanner *)payload;
-
-    size_t size = 0;
-
-    buffer[size++] = (char)scanner->inside_f_string;
-
-    size_t delimiter_count = scanner->delimiters.len;
-    if (delimiter_count > UINT8_MAX) {
-        delimiter_count = UINT8_MAX;
-    }
-    buffer[size++] = (char)delimiter_count;
-
-    if (delimiter_count > 0) {
-        memcpy(&buffer[size], scanner->delimiters.data, delimiter_count);
-    }
-    size += delimiter_count;
-
-    int iter = 1;
-    for (; iter < scanner->indents.len &&
-           size < TREE_SITTER_SERIALIZATION_BUFFER_SIZE;
-         ++iter) {
-        buffer[size++] = (char)scanner->indents.data[iter];
-    }
-
-    return size;
+    memcpy(buffer, payload, sizeof(Scanner));
+    return sizeof(Scanner);
 }
 
 void tree_sitter_coolgen_external_scanner_deserialize(void *payload,
@@ -359,46 +174,22 @@ void tree_sitter_coolgen_external_scanner_deserialize(void *payload,
                                                      unsigned length) {
     Scanner *scanner = (Scanner *)payload;
 
-    VEC_CLEAR(scanner->delimiters);
-    VEC_CLEAR(scanner->indents);
-    VEC_PUSH(scanner->indents, 0);
-
-    if (length > 0) {
-        size_t size = 0;
-
-        scanner->inside_f_string = (bool)buffer[size++];
-
-        size_t delimiter_count = (uint8_t)buffer[size++];
-        if (delimiter_count > 0) {
-            VEC_GROW(scanner->delimiters, delimiter_count);
-            scanner->delimiters.len = delimiter_count;
-            memcpy(scanner->delimiters.data, &buffer[size], delimiter_count);
-            size += delimiter_count;
-        }
-
-        for (; size < length; size++) {
-            VEC_PUSH(scanner->indents, (unsigned char)buffer[size]);
-        }
+    // An empty buffer starts a new document.
+    if (length == sizeof(Scanner)) {
+        memcpy(scanner, buffer, sizeof(Scanner));
+    } else {
+        scanner->current_si = -1;
     }
 }
 
 void *tree_sitter_coolgen_external_scanner_create() {
-#if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L)
-    _Static_assert(sizeof(Delimiter) == sizeof(char), "");
-#else
-    assert(sizeof(Delimiter) == sizeof(char));
-#endif
-    Scanner *scanner = calloc(1, sizeof(Scanner));
-    scanner->indents = indent_vec_new();
-    scanner->delimiters = delimiter_vec_new();
-    scanner->current_si = -1;
+    // With TREE_SITTER_REUSE_ALLOCATOR (binding.gyp) the state comes from the
+    // runtime's allocator, and so from the parse's arena in arena mode.
+    Scanner *scanner = ts_malloc(sizeof(Scanner));
     tree_sitter_coolgen_external_scanner_deserialize(scanner, NULL, 0);
     return scanner;
 }
 
 void tree_sitter_coolgen_external_scanner_destroy(void *payload) {
-    Scanner *scanner = (Scanner *)payload;
-    VEC_FREE(scanner->indents);
-    VEC_FREE(scanner->delimiters);
-    free(scanner);
+    ts_free(payload);
 }